@@ -0,0 +1,135 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "stm32_common.h"
+#include "stm32_async.h"
+
+static stm32_async_t *async_list;
+
+/* 'next' of an unlinked operation is left alone, so a walk standing on it still reaches the list */
+static void async_unlink(stm32_async_t *op)
+{
+    stm32_async_t **link;
+    stm32_critical_t state;
+
+    state = stm32_critical_enter();
+    for (link = &async_list; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == op)
+        {
+            *link = op->next;
+            break;
+        }
+    }
+    stm32_critical_exit(state);
+}
+
+static void async_complete(stm32_async_t *op, int32_t result)
+{
+    async_unlink(op);
+    op->result = result;
+    op->status = STM32_ASYNC_DONE;
+    if (op->done != NULL)
+    {
+        op->done(op, result, op->param);
+    }
+}
+
+sdk_err_t stm32_async_start(stm32_async_t *op, stm32_async_poll_t poll, stm32_async_done_t done, void *param)
+{
+    stm32_critical_t state;
+
+    if (op->status == STM32_ASYNC_RUNNING)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    op->poll = poll;
+    op->done = done;
+    op->param = param;
+    op->line = 0;
+    op->result = STM32_ASYNC_PENDING;
+    op->status = STM32_ASYNC_RUNNING;
+
+    state = stm32_critical_enter();
+    op->next = async_list;
+    async_list = op;
+    stm32_critical_exit(state);
+
+    return SDK_OK;
+}
+
+void stm32_async_cancel(stm32_async_t *op)
+{
+    if (op->status != STM32_ASYNC_RUNNING)
+    {
+        return;
+    }
+    async_unlink(op);
+    op->line = 0;
+    op->status = STM32_ASYNC_IDLE;
+}
+
+uint32_t stm32_async_poll(void)
+{
+    stm32_async_t *op;
+    uint32_t running = 0;
+
+    op = async_list;
+    while (op != NULL)
+    {
+        stm32_async_t *next;
+        int32_t result;
+
+        /* completed or cancelled by a continuation earlier in this pass */
+        if (op->status != STM32_ASYNC_RUNNING)
+        {
+            op = op->next;
+            continue;
+        }
+
+        result = op->poll(op);
+        next = op->next;
+        if (result != STM32_ASYNC_PENDING)
+        {
+            async_complete(op, result);
+        }
+        op = next;
+    }
+
+    for (op = async_list; op != NULL; op = op->next)
+    {
+        running++;
+    }
+
+    return running;
+}
+
+void stm32_async_step(stm32_async_t *op)
+{
+    int32_t result;
+
+    if (op->status != STM32_ASYNC_RUNNING)
+    {
+        return;
+    }
+    result = op->poll(op);
+    if (result != STM32_ASYNC_PENDING)
+    {
+        async_complete(op, result);
+    }
+}
+
+int32_t stm32_async_wait(stm32_async_t *op)
+{
+    while (op->status == STM32_ASYNC_RUNNING)
+    {
+        stm32_async_step(op);
+    }
+
+    return op->result;
+}
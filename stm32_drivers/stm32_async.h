@@ -0,0 +1,122 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_ASYNC_H
+#define __STM32_ASYNC_H
+
+#include "sdk_board.h"
+
+/*
+ * Run to completion event loop for long driver operations. An operation is
+ * a stm32_async_t embedded first in a driver specific struct, plus a poll
+ * function that advances it a step and never blocks. The poll functions are
+ * written as protothreads with the macros below, so their locals do not
+ * survive a wait; keep the state in the operation struct, and use at most
+ * one wait or yield per source line.
+ *
+ * The caller either polls stm32_async_is_done or attaches a continuation,
+ * and runs stm32_async_poll from the main loop. Nothing here touches the
+ * hardware, so the loop runs on a host against simulated poll functions.
+ */
+
+/* returned by a poll function that is not finished, results are SDK_OK or -SDK_E_xxx */
+#define STM32_ASYNC_PENDING         1
+
+#define STM32_ASYNC_IDLE            0
+#define STM32_ASYNC_RUNNING         1
+#define STM32_ASYNC_DONE            2
+
+typedef struct stm32_async stm32_async_t;
+
+typedef int32_t (*stm32_async_poll_t)(stm32_async_t *op);
+typedef void (*stm32_async_done_t)(stm32_async_t *op, int32_t result, void *param);
+
+struct stm32_async
+{
+    stm32_async_t *next;
+    stm32_async_poll_t poll;
+    stm32_async_done_t done;    /* continuation, may be NULL */
+    void *param;
+    uint16_t line;              /* protothread resume point */
+    volatile uint8_t status;
+    int32_t result;
+};
+
+#define STM32_ASYNC_BEGIN(op)           switch ((op)->line) { case 0:
+
+#define STM32_ASYNC_WAIT_UNTIL(op, cond)                    \
+    do                                                      \
+    {                                                       \
+        (op)->line = __LINE__;                              \
+        __attribute__((fallthrough));                       \
+        case __LINE__:                                      \
+        if (!(cond))                                        \
+        {                                                   \
+            return STM32_ASYNC_PENDING;                     \
+        }                                                   \
+    } while (0)
+
+#define STM32_ASYNC_YIELD(op)                               \
+    do                                                      \
+    {                                                       \
+        (op)->line = __LINE__;                              \
+        return STM32_ASYNC_PENDING;                         \
+        case __LINE__:;                                     \
+    } while (0)
+
+#define STM32_ASYNC_EXIT(op, result)                        \
+    do                                                      \
+    {                                                       \
+        (op)->line = 0;                                     \
+        return (result);                                    \
+    } while (0)
+
+#define STM32_ASYNC_END(op)             } (op)->line = 0; return SDK_OK
+
+/**
+  * @brief  Queue an operation, its first step runs on the next stm32_async_poll.
+  * @retval SDK_OK, -SDK_E_INVALID when the operation is already running
+  */
+sdk_err_t stm32_async_start(stm32_async_t *op, stm32_async_poll_t poll, stm32_async_done_t done, void *param);
+
+/**
+  * @brief  Drop a running operation without calling its continuation.
+  * @note   The poll function is not told, so only cancel operations that
+  *         stop between steps in a consistent state.
+  */
+void stm32_async_cancel(stm32_async_t *op);
+
+/**
+  * @brief  Run one step of every queued operation.
+  * @retval Number of operations still running
+  */
+uint32_t stm32_async_poll(void);
+
+/**
+  * @brief  Run one step of op alone, completing it when it finishes.
+  */
+void stm32_async_step(stm32_async_t *op);
+
+/**
+  * @brief  Step op until it completes, for blocking wrappers.
+  * @note   Nothing else runs meanwhile, so no other operation or
+  *         continuation re-enters the caller. An operation waiting on
+  *         another one must be stepped together with it instead.
+  * @retval Result of op
+  */
+int32_t stm32_async_wait(stm32_async_t *op);
+
+static inline uint8_t stm32_async_is_done(stm32_async_t *op)
+{
+    return op->status == STM32_ASYNC_DONE;
+}
+
+static inline int32_t stm32_async_result(stm32_async_t *op)
+{
+    return op->result;
+}
+
+#endif
@@ -7,7 +7,147 @@
 #include "sdk_board.h"
 #include "SEGGER_RTT.h"
 #include "unibus_board.h"
+#include "stm32_common.h"
+#include "stm32_log.h"
+#include <stdarg.h>
 
+#ifdef STM32_CONSOLE_USING_DEFERRED
+/* record layout in the ring: len(2) + systick(4) + text(len) */
+#define CONSOLE_HDR_SIZE    6
+#define CONSOLE_BUF_MASK    (STM32_CONSOLE_BUF_SIZE - 1)
+
+#if (STM32_CONSOLE_BUF_SIZE & CONSOLE_BUF_MASK) != 0
+#error "STM32_CONSOLE_BUF_SIZE must be a power of two"
+#endif
+
+static uint8_t console_buf[STM32_CONSOLE_BUF_SIZE];
+static volatile uint32_t console_head;
+static volatile uint32_t console_tail;
+static volatile uint32_t console_dropped;
+static volatile uint8_t console_draining;
+static uint8_t console_line_start = 1;
+
+static void console_ring_put(uint32_t pos, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        console_buf[(pos + i) & CONSOLE_BUF_MASK] = data[i];
+    }
+}
+
+static void console_ring_get(uint32_t pos, uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        data[i] = console_buf[(pos + i) & CONSOLE_BUF_MASK];
+    }
+}
+
+static void console_sink(const char *str, uint32_t len)
+{
+    SEGGER_RTT_Write(0, str, len);
+    if (g_WellRegMap[WELL_Ctrl_DebugInfoON] == 1 && bl_dev.status.con == 1)
+    {
+        sdk_uart_write(&uart_bl, (uint8_t *)str, len);
+    }
+}
+
+/**
+  * @brief  Queue a console string, never waits for the sinks.
+  * @note   A string that does not fit is dropped whole and counted.
+  */
+void sdk_hw_console_output(const char *str)
+{
+    uint32_t len = strlen(str);
+    uint32_t ts = sdk_hw_get_systick();
+    uint8_t hdr[CONSOLE_HDR_SIZE];
+    stm32_critical_t state;
+
+    hdr[0] = (uint8_t)len;
+    hdr[1] = (uint8_t)(len >> 8);
+    hdr[2] = (uint8_t)ts;
+    hdr[3] = (uint8_t)(ts >> 8);
+    hdr[4] = (uint8_t)(ts >> 16);
+    hdr[5] = (uint8_t)(ts >> 24);
+
+    state = stm32_critical_enter();
+    if (len > 0xFFFF || CONSOLE_HDR_SIZE + len > STM32_CONSOLE_BUF_SIZE - (console_head - console_tail))
+    {
+        console_dropped++;
+    }
+    else
+    {
+        console_ring_put(console_head, hdr, CONSOLE_HDR_SIZE);
+        console_ring_put(console_head + CONSOLE_HDR_SIZE, (const uint8_t *)str, len);
+        console_head += CONSOLE_HDR_SIZE + len;
+    }
+    stm32_critical_exit(state);
+}
+
+/**
+  * @brief  Write queued console records to RTT and the debug uart.
+  * @note   Call it from the main loop or another low priority context. Lines
+  *         are prefixed with the systick they were queued at.
+  */
+void stm32_console_drain(void)
+{
+    char chunk[64];
+    stm32_critical_t state;
+
+    state = stm32_critical_enter();
+    if (console_draining)
+    {
+        stm32_critical_exit(state);
+        return;
+    }
+    console_draining = 1;
+    stm32_critical_exit(state);
+
+    while (console_tail != console_head)
+    {
+        uint8_t hdr[CONSOLE_HDR_SIZE];
+        uint32_t pos = console_tail;
+        uint32_t len;
+        uint32_t ts;
+
+        console_ring_get(pos, hdr, CONSOLE_HDR_SIZE);
+        len = hdr[0] | (hdr[1] << 8);
+        ts = hdr[2] | (hdr[3] << 8) | (hdr[4] << 16) | ((uint32_t)hdr[5] << 24);
+        pos += CONSOLE_HDR_SIZE;
+
+        if (console_line_start && len > 0)
+        {
+            int n = snprintf(chunk, sizeof(chunk), "[%lu] ", (unsigned long)ts);
+            console_sink(chunk, n);
+        }
+
+        while (len > 0)
+        {
+            uint32_t n = (len > sizeof(chunk)) ? sizeof(chunk) : len;
+
+            console_ring_get(pos, (uint8_t *)chunk, n);
+            console_sink(chunk, n);
+            console_line_start = (chunk[n - 1] == '\n');
+            pos += n;
+            len -= n;
+        }
+
+        /* space is only handed back once the record has gone out */
+        console_tail = pos;
+    }
+
+    console_draining = 0;
+}
+
+uint32_t stm32_console_get_dropped(void)
+{
+    return console_dropped;
+}
+#else
 void sdk_hw_console_output(const char *str)
 {
     SEGGER_RTT_WriteString(0, str);
@@ -16,19 +156,150 @@ void sdk_hw_console_output(const char *str)
         sdk_uart_write(&uart_bl, (uint8_t *)str, strlen(str));
     }
 }
+#endif /* STM32_CONSOLE_USING_DEFERRED */
+
+#ifdef STM32_LOG_USING_TOKEN
+static char log_token_rtt_buf[STM32_LOG_TOKEN_RTT_SIZE];
+static uint8_t log_token_ready;
+
+static uint32_t log_token_put32(uint8_t *frame, uint32_t pos, uint32_t value)
+{
+    frame[pos++] = (uint8_t)value;
+    frame[pos++] = (uint8_t)(value >> 8);
+    frame[pos++] = (uint8_t)(value >> 16);
+    frame[pos++] = (uint8_t)(value >> 24);
+    return pos;
+}
+
+/**
+  * @brief  Send one tokenized log frame, see stm32_log.h for the layout.
+  */
+void stm32_log_token(uint32_t token, uint32_t nargs, ...)
+{
+    uint8_t frame[10 + 4 * STM32_LOG_TOKEN_MAX_ARGS];
+    uint32_t len = 0;
+    uint32_t i;
+    va_list ap;
+
+    if (!log_token_ready)
+    {
+        SEGGER_RTT_ConfigUpBuffer(STM32_LOG_TOKEN_RTT_CHANNEL, "log", log_token_rtt_buf,
+                                  sizeof(log_token_rtt_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+        log_token_ready = 1;
+    }
+
+    if (nargs > STM32_LOG_TOKEN_MAX_ARGS)
+    {
+        nargs = STM32_LOG_TOKEN_MAX_ARGS;
+    }
+
+    frame[len++] = STM32_LOG_TOKEN_SYNC;
+    frame[len++] = (uint8_t)nargs;
+    len = log_token_put32(frame, len, token);
+    len = log_token_put32(frame, len, sdk_hw_get_systick());
+
+    va_start(ap, nargs);
+    for (i = 0; i < nargs; i++)
+    {
+        len = log_token_put32(frame, len, va_arg(ap, uint32_t));
+    }
+    va_end(ap);
+
+    SEGGER_RTT_Write(STM32_LOG_TOKEN_RTT_CHANNEL, frame, len);
+    if (g_WellRegMap[WELL_Ctrl_DebugInfoON] == 1 && bl_dev.status.con == 1)
+    {
+        sdk_uart_write(&uart_bl, frame, len);
+    }
+}
+#endif /* STM32_LOG_USING_TOKEN */
 
 void sdk_hw_console_putc(const int ch)
 {
     SEGGER_RTT_PutChar(0, ch);
 }
 
+/* loop count used to calibrate stm32_delay_loops, short enough to fit one SysTick period at MSI */
+#define DELAY_CAL_LOOPS     256
+
+uint32_t stm32_delay_loops_per_us_q16;
+uint32_t stm32_delay_loops_per_ns_q24;
+uint32_t stm32_delay_overhead_loops;
+
+/**
+  * @brief  Busy loop, 'loops' iterations of subs/bne.
+  * @note   Kept out of line and aligned so every caller runs the exact code
+  *         that stm32_delay_init measured. 0 returns at once instead of
+  *         wrapping to 2^32 iterations.
+  */
+__attribute__((noinline, aligned(8))) void stm32_delay_loops(uint32_t loops)
+{
+    if (loops == 0)
+    {
+        return;
+    }
+    __asm volatile (
+        "1: subs %0, %0, #1 \n"
+        "   bne 1b          \n"
+        : "+l" (loops)
+        :
+        : "cc");
+}
+
+/**
+  * @brief  Measure the delay loop against the core clock.
+  * @note   Call it again after changing SystemCoreClock or flash wait states.
+  */
+void stm32_delay_init(void)
+{
+    stm32_critical_t state;
+    uint32_t start;
+    uint32_t overhead;
+    uint32_t cycles;
+    uint32_t cycles_per_loop_q8;
+
+    state = stm32_critical_enter();
+
+    start = SysTick->VAL;
+    stm32_delay_loops(1);
+    overhead = stm32_systick_elapsed(start);
+
+    start = SysTick->VAL;
+    stm32_delay_loops(DELAY_CAL_LOOPS + 1);
+    cycles = stm32_systick_elapsed(start);
+
+    stm32_critical_exit(state);
+
+    cycles_per_loop_q8 = ((cycles - overhead) << 8) / DELAY_CAL_LOOPS;
+    if (cycles_per_loop_q8 == 0)
+    {
+        return;
+    }
+
+    /* fixed cost of a call beyond its first iteration, in whole loops */
+    stm32_delay_overhead_loops = ((overhead << 8) + cycles_per_loop_q8 - 1) / cycles_per_loop_q8 - 1;
+    stm32_delay_loops_per_ns_q24 = ((uint64_t)SystemCoreClock << 32) / (1000000000ULL * cycles_per_loop_q8);
+    stm32_delay_loops_per_us_q16 = ((uint64_t)SystemCoreClock << 24) / (1000000ULL * cycles_per_loop_q8);
+}
+
 void sdk_hw_us_delay(uint32_t us)
 {
     uint32_t ticks;
     uint32_t told, tnow, tcnt = 0;
     uint32_t reload = SysTick->LOAD;
 
-    ticks = us * reload / (1000000 / SDK_SYSTICK_PER_SECOND);
+    if (stm32_delay_loops_per_us_q16 == 0)
+    {
+        stm32_delay_init();
+    }
+
+    /* short waits are cycle counted, polling SysTick costs tens of cycles per step */
+    if (us <= STM32_DELAY_LOOP_MAX_US)
+    {
+        stm32_delay_us(us);
+        return;
+    }
+
+    ticks = (us / STM32_US_PER_SYSTICK) * (reload + 1) + (us % STM32_US_PER_SYSTICK) * (reload + 1) / STM32_US_PER_SYSTICK;
     told = SysTick->VAL;
     while (1)
     {
@@ -52,14 +323,200 @@ void sdk_hw_us_delay(uint32_t us)
     }
 }
 
-void sdk_hw_interrupt_enable(void)
+#ifdef STM32_CRITICAL_USING_STATS
+static stm32_critical_stats_t critical_stats;
+static uint64_t critical_start;
+static uint64_t critical_level_start;
+#endif
+static uint32_t critical_level_depth;
+
+/*
+ * Only the outermost section is timed. stm32_get_cycles masks interrupts
+ * with PRIMASK directly, so it must not use these functions itself.
+ */
+stm32_critical_t stm32_critical_enter(void)
 {
-    __enable_irq();
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+#ifdef STM32_CRITICAL_USING_STATS
+    if (primask == 0)
+    {
+        critical_start = stm32_get_cycles();
+    }
+#endif
+
+    return primask;
 }
 
-void sdk_hw_interrupt_disable(void)
+void stm32_critical_exit(stm32_critical_t state)
+{
+#ifdef STM32_CRITICAL_USING_STATS
+    if (state == 0)
+    {
+        uint32_t cycles = (uint32_t)(stm32_get_cycles() - critical_start);
+
+        if (cycles > critical_stats.max_cycles)
+        {
+            critical_stats.max_cycles = cycles;
+        }
+    }
+#endif
+    __set_PRIMASK(state);
+}
+
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+stm32_critical_t stm32_critical_enter_level(uint32_t level)
 {
+    uint32_t basepri = __get_BASEPRI();
+
+    /* BASEPRI 0 disables masking, level 0 therefore masks everything */
+    if (level == 0)
+    {
+        if (__get_PRIMASK() == 0)
+        {
+            __disable_irq();
+            basepri |= 0x80000000;
+        }
+    }
+    else
+    {
+        __set_BASEPRI_MAX(level << (8 - __NVIC_PRIO_BITS));
+    }
+#ifdef STM32_CRITICAL_USING_STATS
+    if (critical_level_depth == 0)
+    {
+        critical_level_start = stm32_get_cycles();
+    }
+#endif
+    critical_level_depth++;
+
+    return basepri;
+}
+
+static void critical_level_restore(stm32_critical_t state)
+{
+    __set_BASEPRI(state & 0xFF);
+    if (state & 0x80000000)
+    {
+        __enable_irq();
+    }
+}
+#else
+stm32_critical_t stm32_critical_enter_level(uint32_t level)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t enabled;
+    uint32_t mask = 0;
+    uint32_t irq;
+
     __disable_irq();
+    enabled = NVIC->ISER[0];
+    for (irq = 0; irq < 32; irq++)
+    {
+        if ((enabled & (1UL << irq)) && NVIC_GetPriority((IRQn_Type)irq) >= level)
+        {
+            mask |= 1UL << irq;
+        }
+    }
+    NVIC->ICER[0] = mask;
+    __DSB();
+    __ISB();
+#ifdef STM32_CRITICAL_USING_STATS
+    if (critical_level_depth == 0)
+    {
+        critical_level_start = stm32_get_cycles();
+    }
+#endif
+    critical_level_depth++;
+    __set_PRIMASK(primask);
+
+    return mask;
+}
+
+static void critical_level_restore(stm32_critical_t state)
+{
+    NVIC->ISER[0] = state;
+}
+#endif
+
+void stm32_critical_exit_level(stm32_critical_t state)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (critical_level_depth > 0)
+    {
+        critical_level_depth--;
+    }
+#ifdef STM32_CRITICAL_USING_STATS
+    if (critical_level_depth == 0)
+    {
+        uint32_t cycles = (uint32_t)(stm32_get_cycles() - critical_level_start);
+
+        if (cycles > critical_stats.max_level_cycles)
+        {
+            critical_stats.max_level_cycles = cycles;
+        }
+    }
+#endif
+    __set_PRIMASK(primask);
+    critical_level_restore(state);
+}
+
+void stm32_critical_get_stats(stm32_critical_stats_t *stats)
+{
+#ifdef STM32_CRITICAL_USING_STATS
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memcpy(stats, &critical_stats, sizeof(stm32_critical_stats_t));
+    __set_PRIMASK(primask);
+#else
+    memset(stats, 0, sizeof(stm32_critical_stats_t));
+#endif
+}
+
+void stm32_critical_reset_stats(void)
+{
+#ifdef STM32_CRITICAL_USING_STATS
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(&critical_stats, 0, sizeof(stm32_critical_stats_t));
+    __set_PRIMASK(primask);
+#endif
+}
+
+static uint32_t irq_nest;
+static stm32_critical_t irq_state;
+
+/*
+ * Nestable, interrupts come back with the outermost enable. An enable with
+ * no disable pending unmasks them unconditionally, as it always did, for
+ * callers enabling interrupts after init with PRIMASK set.
+ */
+void sdk_hw_interrupt_disable(void)
+{
+    stm32_critical_t state = stm32_critical_enter();
+
+    if (irq_nest++ == 0)
+    {
+        irq_state = state;
+    }
+}
+
+void sdk_hw_interrupt_enable(void)
+{
+    if (irq_nest == 0)
+    {
+        __enable_irq();
+        return;
+    }
+    if (--irq_nest == 0)
+    {
+        stm32_critical_exit(irq_state);
+    }
 }
 
 extern volatile uint32_t systicks;
@@ -68,8 +525,104 @@ uint32_t sdk_hw_get_systick(void)
     return systicks;
 }
 
+static uint32_t time_last_ticks;
+static uint32_t time_ticks_hi;
+
+/**
+  * @brief  Take a coherent 64-bit systick count and SysTick->VAL pair.
+  */
+static uint64_t stm32_time_snapshot(uint32_t *val)
+{
+    uint32_t primask;
+    uint32_t ticks;
+    uint64_t ticks64;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    ticks = systicks;
+    *val = SysTick->VAL;
+    /* the counter wrapped but the tick interrupt has not run yet, VAL is
+     * read again so it belongs to the new period as well */
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        *val = SysTick->VAL;
+        ticks++;
+    }
+
+    if (ticks < time_last_ticks)
+    {
+        time_ticks_hi++;
+    }
+    time_last_ticks = ticks;
+    ticks64 = ((uint64_t)time_ticks_hi << 32) | ticks;
+
+    __set_PRIMASK(primask);
+
+    return ticks64;
+}
+
+uint64_t stm32_get_time_us(void)
+{
+    uint32_t val;
+    uint32_t reload = SysTick->LOAD;
+    uint64_t ticks = stm32_time_snapshot(&val);
+
+    return ticks * STM32_US_PER_SYSTICK + stm32_systick_phase(val, reload) * STM32_US_PER_SYSTICK / (reload + 1);
+}
+
+#if STM32_USING_DWT_CYCCNT
+static uint32_t cycles_last;
+static uint32_t cycles_hi;
+
+uint64_t stm32_get_cycles(void)
+{
+    uint32_t primask;
+    uint32_t now;
+    uint64_t cycles;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    now = DWT->CYCCNT;
+    if (now < cycles_last)
+    {
+        cycles_hi++;
+    }
+    cycles_last = now;
+    cycles = ((uint64_t)cycles_hi << 32) | now;
+
+    __set_PRIMASK(primask);
+
+    return cycles;
+}
+#else
+uint64_t stm32_get_cycles(void)
+{
+    uint32_t val;
+    uint32_t reload = SysTick->LOAD;
+    uint64_t ticks = stm32_time_snapshot(&val);
+
+    return ticks * (reload + 1) + stm32_systick_phase(val, reload);
+}
+#endif /* STM32_USING_DWT_CYCCNT */
+
+__WEAK void stm32_stop_resume_clock(void)
+{
+}
+
 void sdk_hw_system_reset(void)
 {
+#ifdef STM32_CONSOLE_USING_DEFERRED
+    stm32_console_drain();
+#endif
     buzzer_error(APP_ERRNO_SYSTEM_RESET);
     NVIC_SystemReset();
 }
@@ -0,0 +1,173 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_COMMON_H
+#define __STM32_COMMON_H
+
+#include "sdk_board.h"
+
+/* queue console output in RAM and write it out from stm32_console_drain */
+// #define STM32_CONSOLE_USING_DEFERRED
+#ifndef STM32_CONSOLE_BUF_SIZE
+#define STM32_CONSOLE_BUF_SIZE      1024    /* power of two */
+#endif
+
+#define STM32_US_PER_SYSTICK        (1000000 / SDK_SYSTICK_PER_SECOND)
+
+/* longest wait done with the calibrated loop, longer ones poll SysTick */
+#define STM32_DELAY_LOOP_MAX_US     1000
+/* longest wait accepted by stm32_delay_ns */
+#define STM32_DELAY_NS_MAX          20000
+
+/* record the longest interrupt masked span, see stm32_critical_get_stats */
+// #define STM32_CRITICAL_USING_STATS
+
+/*
+ * Threshold for long driver operations (flash programming and erase, EEPROM
+ * writes): only interrupts with a priority value at or above it are masked.
+ * The uart and lpuart RX interrupts default to STM32_UART_IRQ_PRIO (1), below
+ * it, so RX is served between programming units; within a unit (up to
+ * ~3.2 ms) the core stalls on every flash fetch, its ISRs included, so only
+ * the window between units is bounded.
+ */
+#ifndef STM32_CRITICAL_LEVEL_DRIVER
+#define STM32_CRITICAL_LEVEL_DRIVER 2
+#endif
+
+/*
+ * Code that must not fetch from flash, e.g. while the NVM is programming a
+ * half page. The linker script places .RamFunc in RAM (the CubeMX scripts
+ * copy it with .data); long_call since RAM is out of branch range of flash.
+ */
+#define STM32_RAMFUNC               __attribute__((section(".RamFunc"), noinline, long_call))
+
+/* Cortex-M0+ has no DWT cycle counter, the SysTick based one is used instead */
+#if defined(DWT) && defined(__CORTEX_M) && (__CORTEX_M >= 3)
+#define STM32_USING_DWT_CYCCNT      1
+#else
+#define STM32_USING_DWT_CYCCNT      0
+#endif
+
+/**
+  * @brief  Core cycles elapsed since a SysTick->VAL sample.
+  * @note   SysTick is clocked from HCLK and counts down, so this is only valid
+  *         for spans shorter than one SysTick period.
+  * @param  start: SysTick->VAL sampled at the beginning of the span
+  * @retval Elapsed core cycles
+  */
+static inline uint32_t stm32_systick_elapsed(uint32_t start)
+{
+    uint32_t now = SysTick->VAL;
+
+    if (start >= now)
+    {
+        return start - now;
+    }
+    return start + SysTick->LOAD + 1 - now;
+}
+
+/**
+  * @brief  Core cycles into the current SysTick period.
+  * @note   VAL counts down from LOAD and reaching 0 is the tick itself, so 0
+  *         is the start of a period, not its end. stm32_tickless_idle
+  *         resumes SysTick at the phase this gives when it stops.
+  */
+static inline uint32_t stm32_systick_phase(uint32_t val, uint32_t reload)
+{
+    return val == 0 ? 0 : reload + 1 - val;
+}
+
+/**
+  * @brief  Restore the system clock tree after a Stop mode wakeup.
+  * @note   Weak, does nothing. The core resumes on MSI/HSI16, so boards
+  *         running from the PLL override this.
+  */
+void stm32_stop_resume_clock(void);
+
+/**
+  * @brief  Monotonic microseconds since boot, from systicks and SysTick->VAL.
+  * @note   The 32-bit systicks rollover is tracked on each call, so it must be
+  *         called at least once per 2^32 systicks (49 days at 1 kHz).
+  */
+uint64_t stm32_get_time_us(void);
+
+/**
+  * @brief  Monotonic core cycle count since boot.
+  * @note   Uses DWT->CYCCNT where the core has it, then it must be called at
+  *         least once per 2^32 cycles. Otherwise it is derived from SysTick.
+  */
+uint64_t stm32_get_cycles(void);
+
+typedef uint32_t stm32_critical_t;
+
+typedef struct
+{
+    uint32_t max_cycles;        /* longest span with every interrupt masked */
+    uint32_t max_level_cycles;  /* longest span in threshold mode */
+} stm32_critical_stats_t;
+
+/**
+  * @brief  Mask every interrupt, nestable.
+  * @retval State to hand back to stm32_critical_exit
+  */
+stm32_critical_t stm32_critical_enter(void);
+void stm32_critical_exit(stm32_critical_t state);
+
+/**
+  * @brief  Mask only the interrupts with a priority value >= level, nestable.
+  * @note   Uses BASEPRI where the core has it. Cortex-M0+ has no BASEPRI, so
+  *         the affected NVIC lines are disabled instead and their mask is the
+  *         returned state; system exceptions such as SysTick are not masked.
+  * @param  level: priority value, 0 .. (1 << __NVIC_PRIO_BITS) - 1
+  * @retval State to hand back to stm32_critical_exit_level
+  */
+stm32_critical_t stm32_critical_enter_level(uint32_t level);
+void stm32_critical_exit_level(stm32_critical_t state);
+
+void stm32_critical_get_stats(stm32_critical_stats_t *stats);
+void stm32_critical_reset_stats(void);
+
+extern uint32_t stm32_delay_loops_per_us_q16;
+extern uint32_t stm32_delay_loops_per_ns_q24;
+extern uint32_t stm32_delay_overhead_loops;
+
+void stm32_delay_init(void);
+void stm32_delay_loops(uint32_t loops);
+
+/**
+  * @brief  Cycle counted wait of up to STM32_DELAY_NS_MAX nanoseconds.
+  * @note   Requires stm32_delay_init. Resolution is one loop (3-4 cycles),
+  *         interrupts taken during the wait extend it.
+  */
+static inline void stm32_delay_ns(uint32_t ns)
+{
+    uint32_t loops = (ns * stm32_delay_loops_per_ns_q24) >> 24;
+
+    if (loops > stm32_delay_overhead_loops)
+    {
+        stm32_delay_loops(loops - stm32_delay_overhead_loops);
+    }
+}
+
+/**
+  * @brief  Cycle counted wait of up to STM32_DELAY_LOOP_MAX_US microseconds.
+  */
+static inline void stm32_delay_us(uint32_t us)
+{
+    uint32_t loops = (us * stm32_delay_loops_per_us_q16) >> 16;
+
+    if (loops > stm32_delay_overhead_loops)
+    {
+        stm32_delay_loops(loops - stm32_delay_overhead_loops);
+    }
+}
+
+#ifdef STM32_CONSOLE_USING_DEFERRED
+void stm32_console_drain(void);
+uint32_t stm32_console_get_dropped(void);
+#endif
+
+#endif
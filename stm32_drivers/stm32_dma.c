@@ -0,0 +1,338 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "stm32l0xx_ll_dma.h"
+#include "stm32_common.h"
+#include "stm32_dma.h"
+
+#if defined(DMA1_Channel7)
+#define DMA_CHANNELS            7
+#else
+#define DMA_CHANNELS            5
+#endif
+
+#define DMA_CH(n)               (1UL << (n))
+
+/* DMA1->ISR/IFCR, four bits per channel */
+#define DMA_FLAG_TC             0x2
+#define DMA_FLAG_HT             0x4
+#define DMA_FLAG_TE             0x8
+
+struct dma_route
+{
+    uint8_t channels;           /* channels the request can be mapped to */
+    uint8_t request;            /* CSELR value */
+    uint32_t direction;
+    uint32_t periph;
+};
+
+/* RM0367/RM0377 DMA1 request mapping */
+static const struct dma_route dma_routes[STM32_DMA_REQUEST_MAX] =
+{
+    [STM32_DMA_SPI1_RX]    = {DMA_CH(2),             LL_DMA_REQUEST_1,  LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&SPI1->DR},
+    [STM32_DMA_SPI1_TX]    = {DMA_CH(3),             LL_DMA_REQUEST_1,  LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&SPI1->DR},
+    [STM32_DMA_USART1_RX]  = {DMA_CH(3) | DMA_CH(5), LL_DMA_REQUEST_3,  LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&USART1->RDR},
+    [STM32_DMA_USART1_TX]  = {DMA_CH(2) | DMA_CH(4), LL_DMA_REQUEST_3,  LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&USART1->TDR},
+    [STM32_DMA_USART2_RX]  = {DMA_CH(5) | DMA_CH(6), LL_DMA_REQUEST_4,  LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&USART2->RDR},
+    [STM32_DMA_USART2_TX]  = {DMA_CH(4) | DMA_CH(7), LL_DMA_REQUEST_4,  LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&USART2->TDR},
+    [STM32_DMA_LPUART1_RX] = {DMA_CH(3) | DMA_CH(6), LL_DMA_REQUEST_5,  LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&LPUART1->RDR},
+    [STM32_DMA_LPUART1_TX] = {DMA_CH(2) | DMA_CH(7), LL_DMA_REQUEST_5,  LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&LPUART1->TDR},
+#if defined(USART4) && defined(USART5)
+    [STM32_DMA_USART4_RX]  = {DMA_CH(2) | DMA_CH(6), LL_DMA_REQUEST_12, LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&USART4->RDR},
+    [STM32_DMA_USART4_TX]  = {DMA_CH(3) | DMA_CH(7), LL_DMA_REQUEST_12, LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&USART4->TDR},
+    [STM32_DMA_USART5_RX]  = {DMA_CH(2) | DMA_CH(6), LL_DMA_REQUEST_13, LL_DMA_DIRECTION_PERIPH_TO_MEMORY, (uint32_t)&USART5->RDR},
+    [STM32_DMA_USART5_TX]  = {DMA_CH(3) | DMA_CH(7), LL_DMA_REQUEST_13, LL_DMA_DIRECTION_MEMORY_TO_PERIPH, (uint32_t)&USART5->TDR},
+#endif
+};
+
+static stm32_dma_chan_t dma_chans[DMA_CHANNELS + 1];
+
+static IRQn_Type dma_irqn(uint32_t channel)
+{
+    if (channel == 1)
+    {
+        return DMA1_Channel1_IRQn;
+    }
+    if (channel <= 3)
+    {
+        return DMA1_Channel2_3_IRQn;
+    }
+#if defined(DMA1_Channel7)
+    return DMA1_Channel4_5_6_7_IRQn;
+#else
+    return DMA1_Channel4_5_IRQn;
+#endif
+}
+
+/* request lines that can be routed to a channel */
+static uint32_t dma_channel_demand(uint32_t ch)
+{
+    uint32_t demand = 0;
+    uint32_t i;
+
+    for (i = 0; i < STM32_DMA_REQUEST_MAX; i++)
+    {
+        if (dma_routes[i].channels & DMA_CH(ch))
+        {
+            demand++;
+        }
+    }
+    return demand;
+}
+
+/*
+ * Of the free channels a request can use, take the one the fewest other
+ * lines can use, so e.g. a UART does not take channel 2 or 3 from SPI1,
+ * which has no other choice. Ties go to the higher channel.
+ */
+stm32_dma_chan_t *stm32_dma_request(uint32_t request, stm32_dma_callback_t callback, void *param)
+{
+    const struct dma_route *route;
+    stm32_dma_chan_t *chan = NULL;
+    stm32_critical_t state;
+    uint32_t best = 0;
+    uint32_t best_demand = 0;
+    uint32_t ch;
+
+    if (request >= STM32_DMA_REQUEST_MAX || dma_routes[request].channels == 0)
+    {
+        return NULL;
+    }
+    route = &dma_routes[request];
+
+    state = stm32_critical_enter();
+    for (ch = DMA_CHANNELS; ch >= 1; ch--)
+    {
+        if ((route->channels & DMA_CH(ch)) && dma_chans[ch].channel == 0 &&
+            (best == 0 || dma_channel_demand(ch) < best_demand))
+        {
+            best = ch;
+            best_demand = dma_channel_demand(ch);
+        }
+    }
+    if (best != 0)
+    {
+        ch = best;
+        chan = &dma_chans[ch];
+        chan->channel = ch;
+    }
+    stm32_critical_exit(state);
+
+    if (chan == NULL)
+    {
+        return NULL;
+    }
+
+    chan->request = request;
+    chan->callback = callback;
+    chan->param = param;
+    chan->block = NULL;
+    chan->busy = 0;
+
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+    LL_DMA_DisableChannel(DMA1, ch);
+    LL_DMA_SetPeriphRequest(DMA1, ch, route->request);
+    LL_DMA_ConfigTransfer(DMA1, ch, route->direction |
+                          LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                          LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE |
+                          /* a late RX channel loses data, a late TX one only waits */
+                          (route->direction == LL_DMA_DIRECTION_PERIPH_TO_MEMORY ? LL_DMA_PRIORITY_HIGH : LL_DMA_PRIORITY_LOW));
+    LL_DMA_SetPeriphAddress(DMA1, ch, route->periph);
+
+    NVIC_EnableIRQ(dma_irqn(ch));
+
+    return chan;
+}
+
+void stm32_dma_release(stm32_dma_chan_t *chan)
+{
+    if (chan == NULL || chan->channel == 0)
+    {
+        return;
+    }
+    stm32_dma_stop(chan);
+    chan->callback = NULL;
+    chan->channel = 0;
+}
+
+static void dma_load(stm32_dma_chan_t *chan, void *mem, uint16_t len)
+{
+    uint32_t ch = chan->channel;
+
+    LL_DMA_DisableChannel(DMA1, ch);
+    DMA1->IFCR = 0xFUL << ((ch - 1) * 4);
+    LL_DMA_SetMemoryAddress(DMA1, ch, (uint32_t)mem);
+    LL_DMA_SetDataLength(DMA1, ch, len);
+    LL_DMA_EnableChannel(DMA1, ch);
+}
+
+sdk_err_t stm32_dma_start(stm32_dma_chan_t *chan, void *mem, uint16_t len, uint32_t flags)
+{
+    uint32_t ch = chan->channel;
+
+    if (ch == 0 || len == 0)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    LL_DMA_DisableChannel(DMA1, ch);
+    chan->block = NULL;
+    chan->busy = 1;
+
+    LL_DMA_SetMode(DMA1, ch, (flags & STM32_DMA_FLAG_CIRCULAR) ? LL_DMA_MODE_CIRCULAR : LL_DMA_MODE_NORMAL);
+    LL_DMA_EnableIT_TC(DMA1, ch);
+    LL_DMA_EnableIT_TE(DMA1, ch);
+    if (flags & STM32_DMA_FLAG_HALF)
+    {
+        LL_DMA_EnableIT_HT(DMA1, ch);
+    }
+    else
+    {
+        LL_DMA_DisableIT_HT(DMA1, ch);
+    }
+
+    dma_load(chan, mem, len);
+
+    return SDK_OK;
+}
+
+sdk_err_t stm32_dma_start_chain(stm32_dma_chan_t *chan, stm32_dma_block_t *blocks)
+{
+    uint32_t ch = chan->channel;
+
+    if (ch == 0 || blocks == NULL || blocks->len == 0)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    LL_DMA_DisableChannel(DMA1, ch);
+    chan->block = blocks;
+    chan->busy = 1;
+
+    LL_DMA_SetMode(DMA1, ch, LL_DMA_MODE_NORMAL);
+    LL_DMA_EnableIT_TC(DMA1, ch);
+    LL_DMA_EnableIT_TE(DMA1, ch);
+    LL_DMA_DisableIT_HT(DMA1, ch);
+
+    dma_load(chan, blocks->mem, blocks->len);
+
+    return SDK_OK;
+}
+
+void stm32_dma_stop(stm32_dma_chan_t *chan)
+{
+    uint32_t ch = chan->channel;
+
+    if (ch == 0)
+    {
+        return;
+    }
+    LL_DMA_DisableChannel(DMA1, ch);
+    LL_DMA_DisableIT_TC(DMA1, ch);
+    LL_DMA_DisableIT_HT(DMA1, ch);
+    LL_DMA_DisableIT_TE(DMA1, ch);
+    DMA1->IFCR = 0xFUL << ((ch - 1) * 4);
+    chan->block = NULL;
+    chan->busy = 0;
+}
+
+uint32_t stm32_dma_remaining(stm32_dma_chan_t *chan)
+{
+    if (chan->channel == 0)
+    {
+        return 0;
+    }
+    return LL_DMA_GetDataLength(DMA1, chan->channel);
+}
+
+static void dma_irq_handler(uint32_t ch)
+{
+    stm32_dma_chan_t *chan = &dma_chans[ch];
+    uint32_t shift = (ch - 1) * 4;
+    uint32_t flags = (DMA1->ISR >> shift) & 0xF;
+    uint32_t event;
+
+    if (flags == 0)
+    {
+        return;
+    }
+    DMA1->IFCR = flags << shift;
+
+    if (chan->channel == 0)
+    {
+        return;
+    }
+
+    if (flags & DMA_FLAG_TE)
+    {
+        chan->block = NULL;
+        chan->busy = 0;
+        if (chan->callback != NULL)
+        {
+            chan->callback(chan, STM32_DMA_EVENT_ERROR, chan->param);
+        }
+        return;
+    }
+
+    if ((flags & DMA_FLAG_HT) && LL_DMA_IsEnabledIT_HT(DMA1, ch))
+    {
+        if (chan->callback != NULL)
+        {
+            chan->callback(chan, STM32_DMA_EVENT_HALF, chan->param);
+        }
+    }
+
+    if (flags & DMA_FLAG_TC)
+    {
+        if (chan->block != NULL && chan->block->next != NULL)
+        {
+            chan->block = chan->block->next;
+            dma_load(chan, chan->block->mem, chan->block->len);
+            event = STM32_DMA_EVENT_BLOCK;
+        }
+        else
+        {
+            chan->block = NULL;
+            if (LL_DMA_GetMode(DMA1, ch) != LL_DMA_MODE_CIRCULAR)
+            {
+                chan->busy = 0;
+            }
+            event = STM32_DMA_EVENT_DONE;
+        }
+        if (chan->callback != NULL)
+        {
+            chan->callback(chan, event, chan->param);
+        }
+    }
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+    dma_irq_handler(1);
+}
+
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    dma_irq_handler(2);
+    dma_irq_handler(3);
+}
+
+#if defined(DMA1_Channel7)
+void DMA1_Channel4_5_6_7_IRQHandler(void)
+{
+    dma_irq_handler(4);
+    dma_irq_handler(5);
+    dma_irq_handler(6);
+    dma_irq_handler(7);
+}
+#else
+void DMA1_Channel4_5_IRQHandler(void)
+{
+    dma_irq_handler(4);
+    dma_irq_handler(5);
+}
+#endif
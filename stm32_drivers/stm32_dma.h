@@ -0,0 +1,93 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_DMA_H
+#define __STM32_DMA_H
+
+#include "sdk_board.h"
+
+/*
+ * DMA1 channel manager. A driver asks for a request line (e.g. USART2 RX);
+ * the manager picks a free channel among those the L0 can route it to, sets
+ * the CSELR mapping and dispatches the channel interrupts to the driver's
+ * callback. The peripheral side (DMAR/DMAT, SPI RXDMAEN/TXDMAEN) is left to
+ * the driver.
+ */
+
+/* request lines, each with a fixed direction */
+#define STM32_DMA_SPI1_RX           0
+#define STM32_DMA_SPI1_TX           1
+#define STM32_DMA_USART1_RX         2
+#define STM32_DMA_USART1_TX         3
+#define STM32_DMA_USART2_RX         4
+#define STM32_DMA_USART2_TX         5
+#define STM32_DMA_LPUART1_RX        6
+#define STM32_DMA_LPUART1_TX        7
+#define STM32_DMA_USART4_RX         8
+#define STM32_DMA_USART4_TX         9
+#define STM32_DMA_USART5_RX         10
+#define STM32_DMA_USART5_TX         11
+#define STM32_DMA_REQUEST_MAX       12
+
+/* stm32_dma_start flags */
+#define STM32_DMA_FLAG_CIRCULAR     0x01    /* restart at the end, for RX rings */
+#define STM32_DMA_FLAG_HALF         0x02    /* also report the half transfer */
+
+/* callback events */
+#define STM32_DMA_EVENT_HALF        0
+#define STM32_DMA_EVENT_BLOCK       1       /* a chained block is done, the next one runs */
+#define STM32_DMA_EVENT_DONE        2       /* transfer or chain done, each lap when circular */
+#define STM32_DMA_EVENT_ERROR       3       /* the channel is disabled by the hardware */
+
+typedef struct stm32_dma_chan stm32_dma_chan_t;
+
+typedef void (*stm32_dma_callback_t)(stm32_dma_chan_t *chan, uint32_t event, void *param);
+
+/* one link of a chained transfer, must stay valid until the chain is done */
+typedef struct stm32_dma_block
+{
+    struct stm32_dma_block *next;
+    void *mem;
+    uint16_t len;
+} stm32_dma_block_t;
+
+struct stm32_dma_chan
+{
+    uint8_t channel;                /* 1 .. 7, 0 when free */
+    uint8_t request;
+    stm32_dma_callback_t callback;
+    void *param;
+    stm32_dma_block_t *block;       /* chained transfer in progress */
+    volatile uint8_t busy;
+};
+
+/**
+  * @brief  Allocate a channel for a request line.
+  * @retval The channel, NULL when every channel it can use is taken
+  */
+stm32_dma_chan_t *stm32_dma_request(uint32_t request, stm32_dma_callback_t callback, void *param);
+void stm32_dma_release(stm32_dma_chan_t *chan);
+
+/**
+  * @brief  Start a single transfer of len bytes, memory side incremented.
+  */
+sdk_err_t stm32_dma_start(stm32_dma_chan_t *chan, void *mem, uint16_t len, uint32_t flags);
+
+/**
+  * @brief  Run a list of blocks back to back on the same channel.
+  * @note   Blocks are linked from the channel interrupt, so the peripheral
+  *         sees a short gap between them.
+  */
+sdk_err_t stm32_dma_start_chain(stm32_dma_chan_t *chan, stm32_dma_block_t *blocks);
+
+void stm32_dma_stop(stm32_dma_chan_t *chan);
+
+/**
+  * @brief  Bytes left in the current block (CNDTR), the write position of an RX ring.
+  */
+uint32_t stm32_dma_remaining(stm32_dma_chan_t *chan);
+
+#endif
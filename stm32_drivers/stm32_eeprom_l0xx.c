@@ -0,0 +1,235 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "sdk_flash.h"
+#include "stm32_common.h"
+#include "stm32_flash.h"
+
+#define DBG_LVL DBG_LOG
+#define DBG_TAG "mcu.eeprom"
+#include "sdk_log.h"
+#include "stm32_log.h"
+
+#ifndef MCU_EEPROM_START_ADDRESS
+#define MCU_EEPROM_START_ADDRESS    DATA_EEPROM_BASE
+#endif
+#ifndef MCU_EEPROM_END_ADDRESS
+#if defined(DATA_EEPROM_BANK2_END)
+#define MCU_EEPROM_END_ADDRESS      (DATA_EEPROM_BANK2_END + 1)
+#else
+#define MCU_EEPROM_END_ADDRESS      (DATA_EEPROM_END + 1)
+#endif
+#endif
+
+#define EEPROM_PEKEY1               0x89ABCDEFU
+#define EEPROM_PEKEY2               0x02030405U
+#define EEPROM_SR_ERRORS            (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | \
+                                     FLASH_SR_OPTVERR | FLASH_SR_RDERR | FLASH_SR_NOTZEROERR | FLASH_SR_FWWERR)
+
+static void eeprom_unlock(void)
+{
+    if (FLASH->PECR & FLASH_PECR_PELOCK)
+    {
+        FLASH->PEKEYR = EEPROM_PEKEY1;
+        FLASH->PEKEYR = EEPROM_PEKEY2;
+    }
+}
+
+static void eeprom_lock(void)
+{
+    FLASH->PECR |= FLASH_PECR_PELOCK;
+}
+
+static uint8_t eeprom_in_range(uint32_t addr, size_t size)
+{
+    return addr >= MCU_EEPROM_START_ADDRESS && addr + size <= MCU_EEPROM_END_ADDRESS && addr + size >= addr;
+}
+
+/* wait for the write started by the caller, then clear and report the errors */
+static sdk_err_t eeprom_wait(uint32_t addr)
+{
+    uint32_t sr;
+
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+    sr = FLASH->SR;
+    FLASH->SR = sr & (FLASH_SR_EOP | EEPROM_SR_ERRORS);
+    if (sr & EEPROM_SR_ERRORS)
+    {
+        LOG_E("ERROR: write! addr is (0x%08x), sr is 0x%08x\n", (void *)addr, sr);
+        return -SDK_ERROR;
+    }
+    return SDK_OK;
+}
+
+sdk_err_t stm32_eeprom_open(sdk_flash_t *flash)
+{
+    return SDK_OK;
+}
+
+sdk_err_t stm32_eeprom_close(sdk_flash_t *flash)
+{
+    eeprom_lock();
+    return SDK_OK;
+}
+
+int32_t stm32_eeprom_read(sdk_flash_t *flash, uint32_t addr, uint8_t *buf, size_t size)
+{
+    if (!eeprom_in_range(addr, size))
+    {
+        LOG_E("read outrange eeprom size! addr is (0x%08x)", (void *)(addr + size));
+        return -SDK_E_INVALID;
+    }
+
+    memcpy(buf, (const void *)addr, size);
+
+    return size;
+}
+
+/**
+  * @brief  Write any range, as words, half words or bytes depending on alignment.
+  * @note   Units that already hold the data are skipped, which saves the
+  *         erase/program cycle and the wear.
+  */
+int32_t stm32_eeprom_write(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    sdk_err_t result = SDK_OK;
+    uint32_t end_addr = addr + size;
+    stm32_critical_t state;
+
+    if (!eeprom_in_range(addr, size))
+    {
+        LOG_E("write outrange eeprom size! addr is (0x%08x)", (void *)(addr + size));
+        return -SDK_E_INVALID;
+    }
+
+    eeprom_unlock();
+
+    while (addr < end_addr && result == SDK_OK)
+    {
+        uint32_t len;
+
+        if ((addr & 3) == 0 && end_addr - addr >= 4)
+        {
+            uint32_t data = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+
+            len = 4;
+            if (*(volatile uint32_t *)addr != data)
+            {
+                state = stm32_critical_enter_level(STM32_CRITICAL_LEVEL_DRIVER);
+                *(volatile uint32_t *)addr = data;
+                result = eeprom_wait(addr);
+                stm32_critical_exit_level(state);
+            }
+        }
+        else if ((addr & 1) == 0 && end_addr - addr >= 2)
+        {
+            uint16_t data = buf[0] | (buf[1] << 8);
+
+            len = 2;
+            if (*(volatile uint16_t *)addr != data)
+            {
+                state = stm32_critical_enter_level(STM32_CRITICAL_LEVEL_DRIVER);
+                *(volatile uint16_t *)addr = data;
+                result = eeprom_wait(addr);
+                stm32_critical_exit_level(state);
+            }
+        }
+        else
+        {
+            len = 1;
+            if (*(volatile uint8_t *)addr != buf[0])
+            {
+                state = stm32_critical_enter_level(STM32_CRITICAL_LEVEL_DRIVER);
+                *(volatile uint8_t *)addr = buf[0];
+                result = eeprom_wait(addr);
+                stm32_critical_exit_level(state);
+            }
+        }
+
+        if (result == SDK_OK && memcmp((const void *)addr, buf, len) != 0)
+        {
+            LOG_E("ERROR: write read! addr is (0x%08x)\n", (void *)addr);
+            result = -SDK_ERROR;
+        }
+        addr += len;
+        buf  += len;
+    }
+
+    eeprom_lock();
+
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+
+    return size;
+}
+
+/**
+  * @brief  Erase (zero) the words covering [addr, addr + size).
+  * @note   Data EEPROM has no pages, each word is erased on its own and
+  *         words that are already 0 are skipped.
+  */
+sdk_err_t stm32_eeprom_erase(sdk_flash_t *flash, uint32_t addr, size_t size)
+{
+    sdk_err_t result = SDK_OK;
+    uint32_t end_addr = addr + size;
+    stm32_critical_t state;
+
+    if (!eeprom_in_range(addr, size))
+    {
+        LOG_E("ERROR: erase outrange eeprom size! addr is (0x%08x)\n", (void *)(addr + size));
+        return -SDK_E_INVALID;
+    }
+
+    eeprom_unlock();
+
+    for (addr &= ~3UL; addr < end_addr && result == SDK_OK; addr += 4)
+    {
+        if (*(volatile uint32_t *)addr == 0)
+        {
+            continue;
+        }
+        state = stm32_critical_enter_level(STM32_CRITICAL_LEVEL_DRIVER);
+        FLASH->PECR |= FLASH_PECR_ERASE | FLASH_PECR_DATA;
+        *(volatile uint32_t *)addr = 0;
+        result = eeprom_wait(addr);
+        FLASH->PECR &= ~(FLASH_PECR_ERASE | FLASH_PECR_DATA);
+        stm32_critical_exit_level(state);
+    }
+
+    eeprom_lock();
+
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+
+    return size;
+}
+
+sdk_err_t stm32_eeprom_control(sdk_flash_t *flash, int32_t cmd, void *args)
+{
+    switch (cmd)
+    {
+    default:
+        break;
+    }
+
+    return SDK_OK;
+}
+
+sdk_flash_t stm32_onchip_eeprom =
+{
+    .ops.open = stm32_eeprom_open,
+    .ops.close = stm32_eeprom_close,
+    .ops.read = stm32_eeprom_read,
+    .ops.write = stm32_eeprom_write,
+    .ops.erase = stm32_eeprom_erase,
+    .ops.control = stm32_eeprom_control,
+};
@@ -0,0 +1,58 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_FLASH_H
+#define __STM32_FLASH_H
+
+#include "sdk_board.h"
+#include "sdk_flash.h"
+#include "stm32_async.h"
+
+#define STM32_CONTROL_FLASH_BASE            0x80
+#define STM32_CONTROL_FLASH_SET_HALF_PAGE   (STM32_CONTROL_FLASH_BASE + 0)  /* args: uint8_t *, 0 for word writes only */
+#define STM32_CONTROL_FLASH_GET_STATS       (STM32_CONTROL_FLASH_BASE + 1)  /* args: stm32_flash_stats_t * */
+#define STM32_CONTROL_FLASH_RESET_STATS     (STM32_CONTROL_FLASH_BASE + 2)  /* args: unused */
+#define STM32_CONTROL_FLASH_GET_ERASED      (STM32_CONTROL_FLASH_BASE + 3)  /* args: uint32_t *, pages erased by the last erase */
+
+/* value of erased program flash on the L0 */
+#define STM32_FLASH_ERASED_WORD             0x00000000
+
+/*
+ * Longest span write and erase keep interrupts masked. Programming units
+ * (word, half page, page) are grouped in one critical section only while
+ * the longest unit seen so far still fits; a unit alone is about 3.2 ms.
+ */
+#ifndef STM32_FLASH_IRQ_OFF_MAX_US
+#define STM32_FLASH_IRQ_OFF_MAX_US          4000
+#endif
+
+typedef struct
+{
+    uint32_t irq_off_max_us;        /* longest masked window measured */
+    uint32_t unit_max_us;           /* longest single word, half page or page operation */
+} stm32_flash_stats_t;
+
+/* program flash, and the data EEPROM (byte writable, erased per word, see stm32_eeprom_l0xx.c) */
+extern sdk_flash_t stm32_onchip_flash;
+extern sdk_flash_t stm32_onchip_eeprom;
+
+typedef struct
+{
+    stm32_async_t async;
+    uint32_t addr;          /* next page to erase */
+    uint32_t end;
+    uint32_t erased;        /* pages actually erased, blank ones are skipped */
+} stm32_flash_async_t;
+
+/**
+  * @brief  Erase the pages covering [addr, addr + size), one page per
+  *         stm32_async_poll step.
+  * @note   The core still stalls for each page erase when it runs from flash,
+  *         but the main loop gets control back between pages.
+  */
+sdk_err_t stm32_flash_erase_async(stm32_flash_async_t *op, uint32_t addr, size_t size, stm32_async_done_t done, void *param);
+
+#endif
@@ -7,13 +7,71 @@
 #include "sdk_board.h"
 #include "sdk_flash.h"
 #include "stm32l0xx_ll_flash.h"
+#include "stm32_common.h"
+#include "stm32_flash.h"
 
 #define DBG_LVL DBG_LOG
 #define DBG_TAG "mcu.flash"
 #include "sdk_log.h"
+#include "stm32_log.h"
 
 #define ALIGN_DOWN(size, align)      ((size) & ~((align) - 1))
 
+#define FLASH_HALF_PAGE_SIZE         64
+#define FLASH_HALF_PAGE_WORDS        (FLASH_HALF_PAGE_SIZE / 4)
+#define FLASH_SR_ERRORS              (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR | \
+                                      FLASH_SR_OPTVERR | FLASH_SR_RDERR | FLASH_SR_NOTZEROERR | FLASH_SR_FWWERR)
+
+static uint8_t flash_half_page = 1;
+static stm32_flash_stats_t flash_stats;
+static uint64_t flash_section_start;
+
+static uint32_t flash_elapsed_us(uint64_t start)
+{
+    return (uint32_t)((stm32_get_cycles() - start) * 1000000ULL / SystemCoreClock);
+}
+
+static stm32_critical_t flash_section_enter(void)
+{
+    /*
+     * Interrupts below STM32_CRITICAL_LEVEL_DRIVER, e.g. uart RX, stay
+     * unmasked, so they are taken between units. During a unit the core
+     * stalls on any flash fetch, ISRs included, for up to ~3.2 ms.
+     */
+    stm32_critical_t state = stm32_critical_enter_level(STM32_CRITICAL_LEVEL_DRIVER);
+
+    flash_section_start = stm32_get_cycles();
+    return state;
+}
+
+static void flash_section_exit(stm32_critical_t state)
+{
+    uint32_t us = flash_elapsed_us(flash_section_start);
+
+    if (us > flash_stats.irq_off_max_us)
+    {
+        flash_stats.irq_off_max_us = us;
+    }
+    stm32_critical_exit_level(state);
+}
+
+/* close the section when one more unit might overrun STM32_FLASH_IRQ_OFF_MAX_US */
+static stm32_critical_t flash_section_split(stm32_critical_t state, uint64_t unit_start)
+{
+    uint32_t unit_us = flash_elapsed_us(unit_start);
+
+    if (unit_us > flash_stats.unit_max_us)
+    {
+        flash_stats.unit_max_us = unit_us;
+    }
+    if (flash_elapsed_us(flash_section_start) + flash_stats.unit_max_us > STM32_FLASH_IRQ_OFF_MAX_US)
+    {
+        flash_section_exit(state);
+        state = flash_section_enter();
+    }
+    return state;
+}
+
 /**
   * @brief  Gets the page of a given address
   * @param  Addr: Address of the FLASH Memory
@@ -40,7 +98,7 @@ sdk_err_t stm32_flash_close(sdk_flash_t *flash)
 
 int32_t stm32_flash_read(sdk_flash_t *flash, uint32_t addr, uint8_t *buf, size_t size)
 {
-    size_t i;
+    size_t left = size;
 
     if ((addr + size) > MCU_FLASH_END_ADDRESS)
     {
@@ -48,7 +106,31 @@ int32_t stm32_flash_read(sdk_flash_t *flash, uint32_t addr, uint8_t *buf, size_t
         return -SDK_E_INVALID;
     }
 
-    for (i = 0; i < size; i++, buf++, addr++)
+    /* bytes up to a word boundary of flash, then whole words, then the tail */
+    for (; left > 0 && (addr & 3) != 0; left--, buf++, addr++)
+    {
+        *buf = *(uint8_t *) addr;
+    }
+    if (((uint32_t)buf & 3) == 0)
+    {
+        for (; left >= 4; left -= 4, buf += 4, addr += 4)
+        {
+            *(uint32_t *)buf = *(const uint32_t *)addr;
+        }
+    }
+    else
+    {
+        for (; left >= 4; left -= 4, buf += 4, addr += 4)
+        {
+            uint32_t data = *(const uint32_t *)addr;
+
+            buf[0] = (uint8_t)data;
+            buf[1] = (uint8_t)(data >> 8);
+            buf[2] = (uint8_t)(data >> 16);
+            buf[3] = (uint8_t)(data >> 24);
+        }
+    }
+    for (; left > 0; left--, buf++, addr++)
     {
         *buf = *(uint8_t *) addr;
     }
@@ -56,56 +138,246 @@ int32_t stm32_flash_read(sdk_flash_t *flash, uint32_t addr, uint8_t *buf, size_t
     return size;
 }
 
-int32_t stm32_flash_write(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf, size_t size)
+/**
+  * @brief  Program 16 words at a half page aligned address.
+  * @note   Runs from RAM: the 16 writes must reach the NVM back to back, so
+  *         every interrupt is masked for them, and nothing may fetch from
+  *         flash meanwhile. The programming itself runs with the caller's
+  *         mask; interrupt code fetched from flash just stalls until it ends.
+  * @retval FLASH->SR error bits, 0 on success
+  */
+static STM32_RAMFUNC uint32_t flash_program_half_page(uint32_t addr, const uint32_t *data)
+{
+    volatile uint32_t *dst = (volatile uint32_t *)addr;
+    uint32_t primask;
+    uint32_t sr;
+    uint32_t i;
+
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+    FLASH->PECR |= FLASH_PECR_PROG | FLASH_PECR_FPRG;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for (i = 0; i < FLASH_HALF_PAGE_WORDS; i++)
+    {
+        dst[i] = data[i];
+    }
+    __set_PRIMASK(primask);
+
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+    sr = FLASH->SR;
+    FLASH->PECR &= ~(FLASH_PECR_PROG | FLASH_PECR_FPRG);
+    FLASH->SR = sr & (FLASH_SR_EOP | FLASH_SR_ERRORS);
+
+    return sr & FLASH_SR_ERRORS;
+}
+
+static sdk_err_t flash_write_half_page(uint32_t addr, const uint32_t *data)
+{
+    uint32_t errors;
+
+    errors = flash_program_half_page(addr, data);
+    if (errors != 0)
+    {
+        LOG_E("ERROR: half page write! addr is (0x%08x), sr is 0x%08x\n", (void *)(addr), errors);
+        return -SDK_ERROR;
+    }
+    if (memcmp((const void *)addr, data, FLASH_HALF_PAGE_SIZE) != 0)
+    {
+        LOG_E("ERROR: half page write read! addr is (0x%08x)\n", (void *)(addr));
+        return -SDK_ERROR;
+    }
+
+    return SDK_OK;
+}
+
+static sdk_err_t flash_write_word(uint32_t addr, uint32_t data)
+{
+    if (LL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, data) != SUCCESS)
+    {
+        LOG_E("ERROR: write! addr is (0x%08x)\n", (void *)(addr));
+        return -SDK_ERROR;
+    }
+    if (*(uint32_t *)addr != data)
+    {
+        LOG_E("ERROR: write read! addr is (0x%08x), write is %d, read is %d\n", (void *)(addr), *(uint32_t *)addr,  data);
+        return -SDK_ERROR;
+    }
+
+    return SDK_OK;
+}
+
+static uint8_t flash_words_blank(const uint32_t *word, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (word[i] != STM32_FLASH_ERASED_WORD)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint8_t flash_page_blank(uint32_t page)
+{
+    return flash_words_blank((const uint32_t *)page, MCU_FLASH_PAGE_SIZE / 4);
+}
+
+/*
+ * An L0 flash word can only be programmed while it is erased (0), there is
+ * no clearing of single bits. Words already holding their data are fine.
+ */
+static uint8_t flash_needs_erase(uint32_t addr, const uint32_t *words, uint32_t count)
+{
+    const uint32_t *cur = (const uint32_t *)addr;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (cur[i] != STM32_FLASH_ERASED_WORD && cur[i] != words[i])
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+  * @brief  Program words into flash that needs no erase for them.
+  * @note   Half pages where the flash is blank, single words elsewhere;
+  *         words that already hold their data are skipped.
+  */
+static sdk_err_t flash_program(uint32_t addr, const uint32_t *words, uint32_t count)
 {
     sdk_err_t result = SDK_OK;
-    ErrorStatus status = ERROR;
-    uint32_t end_addr = addr + size;
-    uni_data_32_t data32 = {0};
+    stm32_critical_t state;
+    uint32_t i = 0;
 
-    if (addr % 4 != 0)
+    state = flash_section_enter();
+    while (i < count)
     {
-        LOG_E("write addr must be 4-byte alignment");
-        return -SDK_E_INVALID;
+        uint64_t unit_start = stm32_get_cycles();
+        uint32_t waddr = addr + 4 * i;
+
+        if (flash_half_page && (waddr % FLASH_HALF_PAGE_SIZE) == 0 && count - i >= FLASH_HALF_PAGE_WORDS &&
+            flash_words_blank((const uint32_t *)waddr, FLASH_HALF_PAGE_WORDS))
+        {
+            if (!flash_words_blank(&words[i], FLASH_HALF_PAGE_WORDS))
+            {
+                result = flash_write_half_page(waddr, &words[i]);
+            }
+            i += FLASH_HALF_PAGE_WORDS;
+        }
+        else
+        {
+            if (*(const uint32_t *)waddr != words[i])
+            {
+                result = flash_write_word(waddr, words[i]);
+            }
+            i++;
+        }
+        if (result != SDK_OK)
+        {
+            break;
+        }
+        state = flash_section_split(state, unit_start);
     }
+    flash_section_exit(state);
 
-    if ((end_addr) > MCU_FLASH_END_ADDRESS)
+    return result;
+}
+
+static sdk_err_t flash_erase_page(uint32_t page)
+{
+    sdk_err_t result = SDK_OK;
+    uint32_t PAGEError = 0;
+    stm32_critical_t state;
+    uint64_t unit_start;
+    uint32_t unit_us;
+
+    state = flash_section_enter();
+    unit_start = stm32_get_cycles();
+    if (LL_FLASHEx_Erase(FLASH_TYPEERASE_PAGES, page, 1, &PAGEError) != SUCCESS)
+    {
+        result = -SDK_ERROR;
+    }
+    unit_us = flash_elapsed_us(unit_start);
+    if (unit_us > flash_stats.unit_max_us)
+    {
+        flash_stats.unit_max_us = unit_us;
+    }
+    flash_section_exit(state);
+
+    if (result != SDK_OK)
+    {
+        LOG_E("ERROR: erase! addr is (0x%08x)\n", (void *)page);
+    }
+    return result;
+}
+
+/* page image for read-modify-write, word aligned for the programming paths */
+static uint32_t flash_page_buf[MCU_FLASH_PAGE_SIZE / 4];
+
+/**
+  * @brief  Write any address and length, one page at a time.
+  * @note   When the words covering the data are blank (or already hold it)
+  *         they are programmed directly, head and tail bytes merged with the
+  *         current word contents. Otherwise the page is read, erased and
+  *         programmed back with the data merged in.
+  */
+int32_t stm32_flash_write(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    sdk_err_t result = SDK_OK;
+    size_t left = size;
+
+    if ((addr + size) > MCU_FLASH_END_ADDRESS)
     {
         LOG_E("write outrange flash size! addr is (0x%08x)", (void *)(addr + size));
         return -SDK_E_INVALID;
     }
 
-    sdk_hw_interrupt_disable();
     LL_FLASH_Unlock();
 
-    while (addr < end_addr)
+    while (left > 0 && result == SDK_OK)
     {
-        for(int i = 0; i < 4; i++)
+        uint32_t page = GetPage(addr);
+        uint32_t seg = page + MCU_FLASH_PAGE_SIZE - addr;
+        uint32_t wstart = ALIGN_DOWN(addr, 4);
+        uint32_t wcount;
+
+        if (seg > left)
         {
-            data32.data_8[i] = buf[i];
+            seg = left;
         }
-        status = LL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, data32.data_32);
-        if(status == SUCCESS)
+        wcount = (ALIGN_DOWN(addr + seg + 3, 4) - wstart) / 4;
+
+        memcpy(flash_page_buf, (const void *)page, MCU_FLASH_PAGE_SIZE);
+        memcpy((uint8_t *)flash_page_buf + (addr - page), buf, seg);
+
+        if (flash_needs_erase(wstart, &flash_page_buf[(wstart - page) / 4], wcount))
         {
-            if (*(uint32_t *)addr !=  data32.data_32)
+            result = flash_erase_page(page);
+            if (result == SDK_OK)
             {
-                LOG_E("ERROR: write read! addr is (0x%08x), write is %d, read is %d\n", (void *)(addr), *(uint32_t *)addr,  data32.data_32);
-                result = -SDK_ERROR;
-                break;
+                result = flash_program(page, flash_page_buf, MCU_FLASH_PAGE_SIZE / 4);
             }
-            addr += 4;
-            buf  += 4;
         }
         else
         {
-            LOG_E("ERROR: write! addr is (0x%08x)\n", (void *)(addr));
-            result = -SDK_ERROR;
-            break;
+            result = flash_program(wstart, &flash_page_buf[(wstart - page) / 4], wcount);
         }
+
+        addr += seg;
+        buf  += seg;
+        left -= seg;
     }
 
     LL_FLASH_Lock();
-    sdk_hw_interrupt_enable();
 
     if (result != SDK_OK)
     {
@@ -115,39 +387,77 @@ int32_t stm32_flash_write(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf,
     return size;
 }
 
-sdk_err_t stm32_flash_erase(sdk_flash_t *flash, uint32_t addr, size_t size)
+static uint32_t flash_last_erased;
+
+static int32_t stm32_flash_erase_poll(stm32_async_t *async)
 {
-    sdk_err_t result = SDK_OK;
+    stm32_flash_async_t *op = (stm32_flash_async_t *)async;
+    sdk_err_t result;
+
+    /* a blank check is far cheaper than an erase, blank pages cost no step */
+    while (op->addr < op->end && flash_page_blank(op->addr))
+    {
+        op->addr += MCU_FLASH_PAGE_SIZE;
+    }
+    if (op->addr >= op->end)
+    {
+        flash_last_erased = op->erased;
+        return SDK_OK;
+    }
+
+    /* one page per step, the loop gets control back in between */
+    LL_FLASH_Unlock();
+    result = flash_erase_page(op->addr);
+    LL_FLASH_Lock();
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+
+    op->erased++;
+    op->addr += MCU_FLASH_PAGE_SIZE;
+    flash_last_erased = op->erased;
+    return (op->addr < op->end) ? STM32_ASYNC_PENDING : SDK_OK;
+}
 
+sdk_err_t stm32_flash_erase_async(stm32_flash_async_t *op, uint32_t addr, size_t size, stm32_async_done_t done, void *param)
+{
     if ((addr + size) > MCU_FLASH_END_ADDRESS)
     {
         LOG_E("ERROR: erase outrange flash size! addr is (0x%08x)\n", (void *)(addr + size));
         return -SDK_E_INVALID;
     }
 
-    sdk_hw_interrupt_disable();
-    LL_FLASH_Unlock();
+    /* nothing to erase, not the page holding addr; the op still completes on its first step */
+    op->end = addr + size;
+    op->addr = (size == 0) ? op->end : GetPage(addr);
+    op->erased = 0;
 
-    int NbPages = (size + MCU_FLASH_PAGE_SIZE - 1) / MCU_FLASH_PAGE_SIZE;
-    uint32_t PageAddress = GetPage(addr);
-    uint32_t PAGEError = 0;
+    return stm32_async_start(&op->async, stm32_flash_erase_poll, done, param);
+}
 
-    if (LL_FLASHEx_Erase(FLASH_TYPEERASE_PAGES, PageAddress, NbPages, &PAGEError) != SUCCESS)
+sdk_err_t stm32_flash_erase(sdk_flash_t *flash, uint32_t addr, size_t size)
+{
+    stm32_flash_async_t op = {0};
+    sdk_err_t result;
+
+    if (size == 0)
     {
-        result = -SDK_ERROR;
-        goto __exit;
+        return 0;
     }
 
-__exit:
-    LL_FLASH_Lock();
-    sdk_hw_interrupt_enable();
+    result = stm32_flash_erase_async(&op, addr, size, NULL, NULL);
+    if (result == SDK_OK)
+    {
+        result = stm32_async_wait(&op.async);
+    }
 
     if (result != SDK_OK)
     {
         return result;
     }
 
-    LOG_D("erase done: addr (0x%08x), size %d\n", (void *)addr, size);
+    LOG_D("erase done: addr (0x%08x), size %d, %d pages erased\n", (void *)addr, size, op.erased);
     return size;
 }
 
@@ -155,6 +465,30 @@ sdk_err_t stm32_flash_control(sdk_flash_t *flash, int32_t cmd, void *args)
 {
     switch (cmd)
     {
+    case STM32_CONTROL_FLASH_SET_HALF_PAGE:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        flash_half_page = *(uint8_t *)args;
+        break;
+    case STM32_CONTROL_FLASH_GET_STATS:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        memcpy(args, &flash_stats, sizeof(stm32_flash_stats_t));
+        break;
+    case STM32_CONTROL_FLASH_GET_ERASED:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        *(uint32_t *)args = flash_last_erased;
+        break;
+    case STM32_CONTROL_FLASH_RESET_STATS:
+        memset(&flash_stats, 0, sizeof(stm32_flash_stats_t));
+        break;
     default:
         break;
     }
@@ -0,0 +1,106 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Tokenized logging. Include it after sdk_log.h; with STM32_LOG_USING_TOKEN
+ * defined, LOG_D/LOG_I/LOG_W/LOG_E no longer format on the target. The format
+ * string is moved to the .logstr section and its address is sent as a token
+ * along with the raw arguments:
+ *
+ *   0xA5 | nargs | token (u32 le) | systick (u32 le) | args (u32 le) * nargs
+ *
+ * Keep .logstr out of the image in the linker script, e.g.
+ *
+ *   .logstr 0 (INFO) : { KEEP(*(.logstr*)) }
+ *
+ * and rebuild the text on the host with tools/log_token_decode.py and the ELF.
+ * Every argument is sent as 32 bits, so 64-bit and floating point arguments
+ * are not supported. %s arguments are resolved by the host from the ELF, so
+ * they must point at constant strings.
+ */
+
+#ifndef __STM32_LOG_H
+#define __STM32_LOG_H
+
+#include "sdk_board.h"
+
+// #define STM32_LOG_USING_TOKEN
+
+#ifdef STM32_LOG_USING_TOKEN
+
+#ifndef STM32_LOG_TOKEN_RTT_CHANNEL
+#define STM32_LOG_TOKEN_RTT_CHANNEL 1
+#endif
+#ifndef STM32_LOG_TOKEN_RTT_SIZE
+#define STM32_LOG_TOKEN_RTT_SIZE    512
+#endif
+
+#define STM32_LOG_TOKEN_SYNC        0xA5
+#define STM32_LOG_TOKEN_MAX_ARGS    8
+
+void stm32_log_token(uint32_t token, uint32_t nargs, ...);
+
+#define STM32_LOG_NARGS(...)        STM32_LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define STM32_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#define STM32_LOG_CAT(a, b)         STM32_LOG_CAT_(a, b)
+#define STM32_LOG_CAT_(a, b)        a##b
+
+/* ", (uint32_t)(a1), (uint32_t)(a2) ..." or nothing */
+#define STM32_LOG_A0()
+#define STM32_LOG_A1(a)             , (uint32_t)(a)
+#define STM32_LOG_A2(a, ...)        , (uint32_t)(a) STM32_LOG_A1(__VA_ARGS__)
+#define STM32_LOG_A3(a, ...)        , (uint32_t)(a) STM32_LOG_A2(__VA_ARGS__)
+#define STM32_LOG_A4(a, ...)        , (uint32_t)(a) STM32_LOG_A3(__VA_ARGS__)
+#define STM32_LOG_A5(a, ...)        , (uint32_t)(a) STM32_LOG_A4(__VA_ARGS__)
+#define STM32_LOG_A6(a, ...)        , (uint32_t)(a) STM32_LOG_A5(__VA_ARGS__)
+#define STM32_LOG_A7(a, ...)        , (uint32_t)(a) STM32_LOG_A6(__VA_ARGS__)
+#define STM32_LOG_A8(a, ...)        , (uint32_t)(a) STM32_LOG_A7(__VA_ARGS__)
+#define STM32_LOG_ARGS(...)         STM32_LOG_CAT(STM32_LOG_A, STM32_LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#define STM32_LOG_TOKEN(fmt, ...)                                                           \
+    do                                                                                      \
+    {                                                                                       \
+        static const char __log_fmt[] __attribute__((section(".logstr"), used)) = fmt;     \
+        stm32_log_token((uint32_t)__log_fmt, STM32_LOG_NARGS(__VA_ARGS__)                   \
+                        STM32_LOG_ARGS(__VA_ARGS__));                                       \
+    } while (0)
+
+#if !defined(DBG_TAG) && defined(LOG_TAG)
+#define DBG_TAG                     LOG_TAG
+#elif !defined(DBG_TAG)
+#define DBG_TAG                     "NO_TAG"
+#endif
+
+#undef LOG_E
+#undef LOG_W
+#undef LOG_I
+#undef LOG_D
+
+#if (DBG_LVL >= DBG_ERROR)
+#define LOG_E(fmt, ...)             STM32_LOG_TOKEN("E/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(...)
+#endif
+#if (DBG_LVL >= DBG_WARNING)
+#define LOG_W(fmt, ...)             STM32_LOG_TOKEN("W/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(...)
+#endif
+#if (DBG_LVL >= DBG_INFO)
+#define LOG_I(fmt, ...)             STM32_LOG_TOKEN("I/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(...)
+#endif
+#if (DBG_LVL >= DBG_LOG)
+#define LOG_D(fmt, ...)             STM32_LOG_TOKEN("D/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(...)
+#endif
+
+#endif /* STM32_LOG_USING_TOKEN */
+
+#endif
@@ -0,0 +1,203 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "stm32l0xx_ll_lptim.h"
+#include "stm32l0xx_ll_exti.h"
+#include "stm32l0xx_ll_pwr.h"
+#include "stm32l0xx_ll_cortex.h"
+#include "stm32_common.h"
+#include "stm32_timer.h"
+#include "stm32_lowpower.h"
+
+#define LPTIM_PRESCALER         8
+#define LPTIM_MAX_COUNTS        0xFFF0  /* margin below ARR for the wakeup latency */
+#define SYSTICK_RESUME_MARGIN   16      /* cycles, VAL must still be loaded when the restart checks it */
+
+extern volatile uint32_t systicks;
+
+static uint32_t lptim_hz = STM32_TICKLESS_CLOCK_HZ / LPTIM_PRESCALER;
+static uint32_t lptim_remainder;   /* fraction of a SysTick cycle carried between sleeps, in 1/lptim_hz */
+static uint32_t systick_ahead;     /* cycles a resume ran ahead by taking a tick early */
+
+void stm32_tickless_set_clock(uint32_t hz)
+{
+    if (hz >= LPTIM_PRESCALER * SDK_SYSTICK_PER_SECOND)
+    {
+        lptim_hz = hz / LPTIM_PRESCALER;
+    }
+}
+
+static void lptim_start(uint32_t counts)
+{
+    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_LPTIM1);
+#ifdef SDK_RTC_CLOCK_SELECT_LSE
+    LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM1_CLKSOURCE_LSE);
+#else
+    LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM1_CLKSOURCE_LSI);
+#endif
+
+    /* CFGR is only writable while disabled */
+    LL_LPTIM_Disable(LPTIM1);
+    LL_LPTIM_SetClockSource(LPTIM1, LL_LPTIM_CLK_SOURCE_INTERNAL);
+    LL_LPTIM_SetPrescaler(LPTIM1, LL_LPTIM_PRESCALER_DIV8);
+    LL_LPTIM_SetCounterMode(LPTIM1, LL_LPTIM_COUNTER_MODE_INTERNAL);
+    LL_LPTIM_SetUpdateMode(LPTIM1, LL_LPTIM_UPDATE_MODE_IMMEDIATE);
+    LL_LPTIM_TrigSw(LPTIM1);
+    LL_LPTIM_DisableIT_ARRM(LPTIM1);
+    LL_LPTIM_EnableIT_CMPM(LPTIM1);
+
+    LL_LPTIM_Enable(LPTIM1);
+    LL_LPTIM_ClearFlag_ARROK(LPTIM1);
+    LL_LPTIM_SetAutoReload(LPTIM1, 0xFFFF);
+    while (!LL_LPTIM_IsActiveFlag_ARROK(LPTIM1))
+        ;
+    LL_LPTIM_ClearFlag_CMPOK(LPTIM1);
+    LL_LPTIM_SetCompare(LPTIM1, counts);
+    while (!LL_LPTIM_IsActiveFlag_CMPOK(LPTIM1))
+        ;
+    LL_LPTIM_ClearFLAG_CMPM(LPTIM1);
+    LL_LPTIM_StartCounter(LPTIM1, LL_LPTIM_OPERATING_MODE_CONTINUOUS);
+}
+
+/* the counter runs on its own clock, a read is only valid when two agree */
+static uint32_t lptim_read(void)
+{
+    uint32_t a;
+    uint32_t b = LL_LPTIM_GetCounter(LPTIM1);
+
+    do
+    {
+        a = b;
+        b = LL_LPTIM_GetCounter(LPTIM1);
+    } while (a != b);
+
+    return a;
+}
+
+static void lptim_stop(void)
+{
+    LL_LPTIM_Disable(LPTIM1);
+    LL_LPTIM_ClearFLAG_CMPM(LPTIM1);
+    NVIC_ClearPendingIRQ(LPTIM1_IRQn);
+}
+
+void stm32_tickless_idle(void)
+{
+    uint32_t next, ticks, counts, elapsed, extra = 0;
+    uint32_t reload, phase, ahead;
+    uint64_t total;
+    uint32_t primask;
+
+    /* PRIMASK directly, the sleep must not count as masked time in the stats */
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* LPTIM1 busy elsewhere (LSI calibration), which also needs SysTick running */
+    next = stm32_timer_next_expiry();
+    if (next < STM32_TICKLESS_MIN_TICKS || LL_LPTIM_IsEnabled(LPTIM1))
+    {
+        __set_PRIMASK(primask);
+        __WFI();
+        return;
+    }
+
+    /* stop SysTick, a tick that slipped in meanwhile is handled normally */
+    SysTick->CTRL &= ~(SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk);
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk;
+        __set_PRIMASK(primask);
+        return;
+    }
+    /* the part of the current tick already run, it continues after the sleep */
+    reload = SysTick->LOAD;
+    phase = stm32_systick_phase(SysTick->VAL, reload);
+
+    /* wake one tick early, the restarted SysTick then runs the due tick */
+    ticks = next - 1;
+    if (ticks > (uint32_t)((uint64_t)LPTIM_MAX_COUNTS * SDK_SYSTICK_PER_SECOND / lptim_hz))
+    {
+        ticks = (uint64_t)LPTIM_MAX_COUNTS * SDK_SYSTICK_PER_SECOND / lptim_hz;
+    }
+    counts = (uint64_t)ticks * lptim_hz / SDK_SYSTICK_PER_SECOND;
+
+    lptim_start(counts);
+    LL_EXTI_EnableIT_0_31(LL_EXTI_LINE_29);
+    NVIC_EnableIRQ(LPTIM1_IRQn);
+
+    LL_PWR_ClearFlag_WU();
+    LL_PWR_SetPowerMode(LL_PWR_MODE_STOP);
+    LL_LPM_EnableDeepSleep();
+    __DSB();
+    __WFI();
+    LL_LPM_EnableSleep();
+    stm32_stop_resume_clock();
+
+    elapsed = lptim_read();
+    lptim_stop();
+
+    /* the sleep in SysTick cycles, less a lead kept from an earlier resume, on top of the phase it started at */
+    total = (uint64_t)elapsed * (reload + 1) * SDK_SYSTICK_PER_SECOND + lptim_remainder;
+    lptim_remainder = total % lptim_hz;
+    total /= lptim_hz;
+    ahead = total < systick_ahead ? (uint32_t)total : systick_ahead;
+    systick_ahead -= ahead;
+    total += phase - ahead;
+    elapsed = total / (reload + 1);
+    phase = total % (reload + 1);
+    /* too close to the next tick to restart SysTick within it, that tick is taken now */
+    if (phase + SYSTICK_RESUME_MARGIN > reload + 1)
+    {
+        systick_ahead += reload + 1 - phase;
+        elapsed++;
+        phase = 0;
+    }
+
+    /* a late wakeup may overshoot, those ticks are run after the mask is restored */
+    if (elapsed > ticks)
+    {
+        extra = elapsed - ticks;
+        elapsed = ticks;
+    }
+    systicks += elapsed + extra;
+    stm32_timer_advance(elapsed);
+
+    /*
+     * The first period only runs the rest of the tick. Writing VAL clears
+     * it and the first clock after the enable copies LOAD into it; until
+     * then VAL reads 0, so LOAD is put back only once it has been taken.
+     */
+    SysTick->LOAD = reload - phase;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk;
+    while (SysTick->VAL == 0)
+        ;
+    SysTick->LOAD = reload;
+    __set_PRIMASK(primask);
+
+    if (extra != 0)
+    {
+        stm32_timer_advance(extra);
+    }
+}
+
+__WEAK void stm32_lptim_reload_callback(void)
+{
+}
+
+void LPTIM1_IRQHandler(void)
+{
+    if (LL_LPTIM_IsActiveFlag_CMPM(LPTIM1))
+    {
+        LL_LPTIM_ClearFLAG_CMPM(LPTIM1);
+    }
+    if (LL_LPTIM_IsActiveFlag_ARRM(LPTIM1) && LL_LPTIM_IsEnabledIT_ARRM(LPTIM1))
+    {
+        LL_LPTIM_ClearFLAG_ARRM(LPTIM1);
+        stm32_lptim_reload_callback();
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_LOWPOWER_H
+#define __STM32_LOWPOWER_H
+
+#include "sdk_board.h"
+
+/*
+ * Tickless idle. SysTick is stopped and LPTIM1, which keeps counting in Stop
+ * mode, wakes the core when the next stm32_timer deadline is due. On wakeup
+ * the sleep is measured from the LPTIM counter, systicks is corrected and the
+ * timer wheel is advanced, so sleeps cut short by another interrupt stay exact.
+ * SysTick resumes at the phase of the tick it was stopped in, so the part of
+ * a tick run before the sleep is kept and stm32_get_time_us never steps back;
+ * tools/tickless_check.c checks both on the host.
+ */
+
+/* shorter idle periods only WFI, Stop entry and exit cost more than they save */
+#ifndef STM32_TICKLESS_MIN_TICKS
+#define STM32_TICKLESS_MIN_TICKS    3
+#endif
+
+/* LPTIM1 kernel clock before the /8 prescaler, refined by stm32_tickless_set_clock */
+#ifndef STM32_TICKLESS_CLOCK_HZ
+#ifdef SDK_RTC_CLOCK_SELECT_LSE
+#define STM32_TICKLESS_CLOCK_HZ     32768
+#else
+#define STM32_TICKLESS_CLOCK_HZ     37000
+#endif
+#endif
+
+/**
+  * @brief  Sleep in Stop mode until the next timer deadline or interrupt.
+  * @note   Call it from the idle loop with interrupts enabled.
+  */
+void stm32_tickless_idle(void);
+
+/**
+  * @brief  Set the measured LPTIM1 kernel clock, e.g. after LSI calibration.
+  */
+void stm32_tickless_set_clock(uint32_t hz);
+
+/**
+  * @brief  LPTIM1 auto-reload match, for the other user of LPTIM1: the RTC
+  *         LSI calibration. Tickless idle only sleeps while LPTIM1 is off.
+  */
+void stm32_lptim_reload_callback(void);
+
+#endif
@@ -6,13 +6,23 @@
 
 #include "sdk_board.h"
 #include "sdk_uart.h"
+#include "stm32_uart.h"
+#include "stm32_common.h"
+#include "stm32_trace.h"
+#include "stm32l0xx_ll_exti.h"
 
 #define DBG_TAG "bsp.lpuart"
 #define DBG_LVL DBG_LOG
 #include "sdk_log.h"
+#include "stm32_log.h"
 
 extern sdk_uart_t lpuart;
 
+static stm32_uart_stats_t lpuart_stats;
+static void (*lpuart_match_callback)(void);
+
+void lpuart_wakeup_callback(void);
+
 __WEAK int stm32_lpuart_msp_init(sdk_uart_t *uart)
 {
     return -SDK_ERROR;
@@ -111,6 +121,7 @@ static int32_t stm32_lpuart_putc(sdk_uart_t *uart, int32_t ch)
 {
     while(0 == LL_LPUART_IsActiveFlag_TXE(uart->instance));
     LL_LPUART_TransmitData8(uart->instance, (uint8_t) ch);
+    lpuart_stats.tx_bytes++;
     return ch;
 }
 
@@ -120,10 +131,105 @@ static int32_t stm32_lpuart_getc(sdk_uart_t *uart)
 
     ch = -1;
     if (LL_LPUART_IsActiveFlag_RXNE(uart->instance) != 0)
+    {
         ch = LL_LPUART_ReceiveData8(uart->instance);
+        lpuart_stats.rx_bytes++;
+    }
     return ch;
 }
 
+/**
+  * @brief  Arm or disarm LPUART wakeup from Stop mode.
+  * @note   The LPUART kernel clock must be HSI16 or LSE for this to work in
+  *         Stop mode, that is selected by stm32_lpuart_msp_init.
+  */
+static int32_t stm32_lpuart_set_wakeup(sdk_uart_t *uart, stm32_uart_wakeup_t *wakeup)
+{
+    int32_t result = SDK_OK;
+
+    if (wakeup == NULL)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    /* WUS and ADD can only be written while UE is cleared */
+    LL_LPUART_DisableIT_WKUP(uart->instance);
+    LL_LPUART_DisableInStopMode(uart->instance);
+    LL_LPUART_Disable(uart->instance);
+
+    switch (wakeup->mode)
+    {
+    case STM32_UART_WAKEUP_STARTBIT:
+        LL_LPUART_SetWKUPType(uart->instance, LL_LPUART_WAKEUP_ON_STARTBIT);
+        break;
+    case STM32_UART_WAKEUP_RXNE:
+        LL_LPUART_SetWKUPType(uart->instance, LL_LPUART_WAKEUP_ON_RXNE);
+        break;
+    case STM32_UART_WAKEUP_ADDRESS:
+        LL_LPUART_ConfigNodeAddress(uart->instance,
+                                    (wakeup->address_len == 4) ? LL_LPUART_ADDRESS_DETECT_4B : LL_LPUART_ADDRESS_DETECT_7B,
+                                    wakeup->address);
+        LL_LPUART_SetWKUPType(uart->instance, LL_LPUART_WAKEUP_ON_ADDRESS);
+        break;
+    case STM32_UART_WAKEUP_NONE:
+        LL_EXTI_DisableIT_0_31(LL_EXTI_LINE_28);
+        LL_LPUART_Enable(uart->instance);
+        return SDK_OK;
+    default:
+        result = -SDK_E_INVALID;
+        break;
+    }
+
+    if (result == SDK_OK)
+    {
+        LL_LPUART_EnableInStopMode(uart->instance);
+    }
+    LL_LPUART_Enable(uart->instance);
+
+    /* Stop mode must not be entered before the receiver is ready again */
+    while (0 == LL_LPUART_IsActiveFlag_REACK(uart->instance))
+    {
+    }
+
+    if (result == SDK_OK)
+    {
+        /* LPUART1 wakeup event is routed on EXTI line 28 */
+        LL_EXTI_EnableIT_0_31(LL_EXTI_LINE_28);
+        LL_LPUART_ClearFlag_WKUP(uart->instance);
+        LL_LPUART_EnableIT_WKUP(uart->instance);
+    }
+
+    return result;
+}
+
+static int32_t stm32_lpuart_set_char_match(sdk_uart_t *uart, stm32_uart_char_match_t *match)
+{
+    if (match == NULL)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    LL_LPUART_DisableIT_CM(uart->instance);
+    lpuart_match_callback = match->callback;
+    if (match->enable == 0)
+    {
+        return SDK_OK;
+    }
+
+    /* ADD can only be written while UE is cleared, outside mute mode all 8 bits are compared */
+    LL_LPUART_Disable(uart->instance);
+    LL_LPUART_ConfigNodeAddress(uart->instance, LL_LPUART_ADDRESS_DETECT_7B, match->ch);
+    LL_LPUART_Enable(uart->instance);
+    while (0 == LL_LPUART_IsActiveFlag_REACK(uart->instance))
+    {
+    }
+
+    LL_LPUART_ClearFlag_CM(uart->instance);
+    LL_LPUART_EnableIT_CM(uart->instance);
+
+    return SDK_OK;
+}
+
 static int32_t stm32_lpuart_control(sdk_uart_t *uart, int32_t cmd, void *args)
 {
     switch (cmd)
@@ -156,6 +262,24 @@ static int32_t stm32_lpuart_control(sdk_uart_t *uart, int32_t cmd, void *args)
     case SDK_CONTROL_UART_DISABLE_RX:
         LL_LPUART_DisableDirectionRx(uart->instance);
         break;
+    case STM32_CONTROL_UART_GET_STATS:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        sdk_hw_interrupt_disable();
+        memcpy(args, &lpuart_stats, sizeof(stm32_uart_stats_t));
+        sdk_hw_interrupt_enable();
+        break;
+    case STM32_CONTROL_UART_RESET_STATS:
+        sdk_hw_interrupt_disable();
+        memset(&lpuart_stats, 0, sizeof(stm32_uart_stats_t));
+        sdk_hw_interrupt_enable();
+        break;
+    case STM32_CONTROL_UART_SET_CHAR_MATCH:
+        return stm32_lpuart_set_char_match(uart, (stm32_uart_char_match_t *)args);
+    case STM32_CONTROL_UART_SET_WAKEUP:
+        return stm32_lpuart_set_wakeup(uart, (stm32_uart_wakeup_t *)args);
     }
 
     return SDK_OK;
@@ -163,14 +287,44 @@ static int32_t stm32_lpuart_control(sdk_uart_t *uart, int32_t cmd, void *args)
 
 void LPUART1_IRQHandler(void)
 {
+    uint32_t start = SysTick->VAL;
+    uint32_t cycles;
+
+    STM32_TRACE_BEGIN(STM32_TRACE_ID_LPUART_ISR);
+    /* serviced first so the clocks are back before the pending byte is read */
+    if(LL_LPUART_IsActiveFlag_WKUP(LPUART1) && LL_LPUART_IsEnabledIT_WKUP(LPUART1))
+    {
+        LL_LPUART_ClearFlag_WKUP(LPUART1);
+        stm32_stop_resume_clock();
+        lpuart_wakeup_callback();
+    }
+
     if(LL_LPUART_IsActiveFlag_RXNE(LPUART1) && LL_LPUART_IsEnabledIT_RXNE(LPUART1))
     {
+        int32_t len;
+
         sdk_uart_rx_isr(&lpuart);
+        len = stm32_uart_rx_fifo_len(&lpuart);
+        if(len > 0 && (uint32_t)len > lpuart_stats.rx_fifo_hwm)
+        {
+            lpuart_stats.rx_fifo_hwm = len;
+        }
+    }
+
+    /* after RXNE, so the delimiter is already in the rx fifo */
+    if(LL_LPUART_IsActiveFlag_CM(LPUART1) && LL_LPUART_IsEnabledIT_CM(LPUART1))
+    {
+        LL_LPUART_ClearFlag_CM(LPUART1);
+        if(lpuart_match_callback != NULL)
+        {
+            lpuart_match_callback();
+        }
     }
 
     if(LL_LPUART_IsActiveFlag_IDLE(LPUART1) && LL_LPUART_IsEnabledIT_IDLE(LPUART1))
     {
         LL_LPUART_ClearFlag_IDLE(LPUART1);
+        lpuart_stats.rx_frames++;
         if(lpuart.rx_idle_callback != NULL)
         {
             lpuart.rx_idle_callback();
@@ -179,15 +333,25 @@ void LPUART1_IRQHandler(void)
     if(LL_LPUART_IsActiveFlag_ORE(LPUART1))
     {
         LL_LPUART_ClearFlag_ORE(LPUART1);
+        lpuart_stats.overrun_errors++;
     }
     if(LL_LPUART_IsActiveFlag_FE(LPUART1))
     {
         LL_LPUART_ClearFlag_FE(LPUART1);
+        lpuart_stats.framing_errors++;
     }
-        if(LL_LPUART_IsActiveFlag_NE(LPUART1))
+    if(LL_LPUART_IsActiveFlag_NE(LPUART1))
     {
         LL_LPUART_ClearFlag_NE(LPUART1);
+        lpuart_stats.noise_errors++;
+    }
+
+    cycles = stm32_systick_elapsed(start);
+    if(cycles > lpuart_stats.isr_max_cycles)
+    {
+        lpuart_stats.isr_max_cycles = cycles;
     }
+    STM32_TRACE_END(STM32_TRACE_ID_LPUART_ISR);
 }
 
 __WEAK void lpuart_wakeup_callback(void)
@@ -199,7 +363,7 @@ sdk_uart_t lpuart =
 {
     .instance = LPUART1,
     .irq = LPUART1_IRQn,
-    .irq_prio = 1,
+    .irq_prio = STM32_UART_IRQ_PRIO,
     .ops.open = stm32_lpuart_open,
     .ops.close = stm32_lpuart_close,
     .ops.putc = stm32_lpuart_putc,
@@ -0,0 +1,242 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "sdk_flash.h"
+#include "stm32l0xx_ll_crc.h"
+#include "stm32_flash.h"
+#include "stm32_settings.h"
+#include "stm32_ota.h"
+
+#define DBG_LVL DBG_LOG
+#define DBG_TAG "mcu.ota"
+#include "sdk_log.h"
+#include "stm32_log.h"
+
+/* saved in the settings store, only resumed for the same image */
+struct ota_marker
+{
+    uint32_t src;
+    uint32_t dst;
+    uint32_t size;
+    uint32_t crc;
+    uint32_t offset;
+    uint32_t crc_now;
+};
+
+static uint32_t ota_buf[2][STM32_OTA_BLOCK_SIZE / 4];
+
+static uint32_t ota_bitrev(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555UL) | ((x & 0x55555555UL) << 1);
+    x = ((x >> 2) & 0x33333333UL) | ((x & 0x33333333UL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0FUL) | ((x & 0x0F0F0F0FUL) << 4);
+    x = ((x >> 8) & 0x00FF00FFUL) | ((x & 0x00FF00FFUL) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/*
+ * CRC-32 (IEEE) of data appended to crc, on the CRC unit. The unit shifts
+ * MSB first, so input and output are bit reversed, and a running CRC is
+ * resumed by loading its register form into INIT. data is word aligned.
+ */
+static uint32_t ota_crc(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_CRC);
+    LL_CRC_SetPolynomialSize(CRC, LL_CRC_POLYLENGTH_32B);
+    LL_CRC_SetPolynomialCoef(CRC, LL_CRC_DEFAULT_CRC32_POLY);
+    LL_CRC_SetOutputDataReverseMode(CRC, LL_CRC_OUTDATA_REVERSE_BIT);
+    LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_WORD);
+    LL_CRC_SetInitialData(CRC, ota_bitrev(~crc));
+    LL_CRC_ResetCRCCalculationUnit(CRC);
+
+    for (; len >= 4; len -= 4, data += 4)
+    {
+        LL_CRC_FeedData32(CRC, *(const uint32_t *)data);
+    }
+    LL_CRC_SetInputDataReverseMode(CRC, LL_CRC_INDATA_REVERSE_BYTE);
+    for (; len > 0; len--, data++)
+    {
+        LL_CRC_FeedData8(CRC, *data);
+    }
+
+    return ~LL_CRC_ReadData32(CRC);
+}
+
+static uint32_t ota_block_len(stm32_ota_t *op, uint32_t offset)
+{
+    return op->size - offset > STM32_OTA_BLOCK_SIZE ? STM32_OTA_BLOCK_SIZE : op->size - offset;
+}
+
+static sdk_err_t ota_read(stm32_ota_t *op, uint32_t offset, uint8_t buf)
+{
+    if (w25qxx_read_async(&op->read, op->w25qxx, op->src + offset, (uint8_t *)ota_buf[buf],
+                          ota_block_len(op, offset), NULL, NULL) != W25QXX_Ok)
+    {
+        return -SDK_ERROR;
+    }
+    return SDK_OK;
+}
+
+static void ota_marker_save(stm32_ota_t *op)
+{
+    struct ota_marker marker =
+    {
+        .src = op->src,
+        .dst = op->dst,
+        .size = op->size,
+        .crc = op->crc,
+        .offset = op->offset,
+        .crc_now = op->crc_now,
+    };
+
+    if (stm32_settings_set(STM32_OTA_SETTINGS_KEY, &marker, sizeof(marker)) != SDK_OK)
+    {
+        LOG_W("progress marker not saved\n");
+    }
+}
+
+/* erase the pages of the block at offset, program it and fold it into the image CRC */
+static sdk_err_t ota_program(stm32_ota_t *op)
+{
+    uint32_t addr = op->dst + op->offset;
+    uint32_t len = ota_block_len(op, op->offset);
+    int32_t ret;
+
+    ret = stm32_onchip_flash.ops.erase(&stm32_onchip_flash, addr, len);
+    if (ret >= 0)
+    {
+        ret = stm32_onchip_flash.ops.write(&stm32_onchip_flash, addr, (const uint8_t *)ota_buf[op->cur], len);
+    }
+    if (ret < 0)
+    {
+        LOG_E("program failed at 0x%08x\n", (void *)addr);
+        return ret;
+    }
+
+    op->crc_now = ota_crc(op->crc_now, (const uint8_t *)addr, len);
+    op->offset += len;
+    return SDK_OK;
+}
+
+static int32_t ota_poll(stm32_async_t *async)
+{
+    stm32_ota_t *op = (stm32_ota_t *)async;
+
+    STM32_ASYNC_BEGIN(async);
+    if (ota_read(op, op->offset, op->cur) != SDK_OK)
+    {
+        STM32_ASYNC_EXIT(async, -SDK_ERROR);
+    }
+    STM32_ASYNC_WAIT_UNTIL(async, stm32_async_is_done(&op->read.async));
+
+    while (op->offset < op->size)
+    {
+        if (stm32_async_result(&op->read.async) != SDK_OK)
+        {
+            LOG_E("read failed at 0x%08x\n", (void *)(op->src + op->offset));
+            STM32_ASYNC_EXIT(async, -SDK_ERROR);
+        }
+
+        /* the next block comes in on DMA while this one is programmed */
+        if (op->offset + ota_block_len(op, op->offset) < op->size)
+        {
+            if (ota_read(op, op->offset + ota_block_len(op, op->offset), op->cur ^ 1) != SDK_OK)
+            {
+                STM32_ASYNC_EXIT(async, -SDK_ERROR);
+            }
+            /* one loop pass, for the read to send its command and start the transfer */
+            STM32_ASYNC_YIELD(async);
+        }
+
+        op->error = ota_program(op);
+        if (op->error != SDK_OK)
+        {
+            /* the prefetch holds SPI1, its DMA and a node of the loop until it ends */
+            STM32_ASYNC_WAIT_UNTIL(async, op->read.async.status != STM32_ASYNC_RUNNING);
+            STM32_ASYNC_EXIT(async, op->error);
+        }
+        op->cur ^= 1;
+
+        if (++op->blocks >= STM32_OTA_MARKER_BLOCKS)
+        {
+            op->blocks = 0;
+            ota_marker_save(op);
+        }
+
+        if (op->offset < op->size)
+        {
+            STM32_ASYNC_WAIT_UNTIL(async, stm32_async_is_done(&op->read.async));
+        }
+    }
+
+    /* done either way, a bad image is copied again from the start */
+    stm32_settings_delete(STM32_OTA_SETTINGS_KEY);
+    if (op->crc_now != op->crc)
+    {
+        LOG_E("image crc 0x%08x, expected 0x%08x\n", op->crc_now, op->crc);
+        STM32_ASYNC_EXIT(async, -SDK_ERROR);
+    }
+    LOG_I("image of %d bytes written\n", op->size);
+    STM32_ASYNC_END(async);
+}
+
+sdk_err_t stm32_ota_start(stm32_ota_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t src, uint32_t dst, uint32_t size,
+                          uint32_t crc, stm32_async_done_t done, void *param)
+{
+    struct ota_marker marker;
+
+    if (op->async.status == STM32_ASYNC_RUNNING || op->read.async.status == STM32_ASYNC_RUNNING)
+    {
+        return -SDK_E_INVALID;
+    }
+    if (size == 0 || (dst % MCU_FLASH_PAGE_SIZE) != 0 || dst < MCU_FLASH_START_ADRESS || dst + size > MCU_FLASH_END_ADDRESS ||
+        (dst < STM32_SETTINGS_ADDRESS + 2 * STM32_SETTINGS_BANK_SIZE && dst + size > STM32_SETTINGS_ADDRESS))
+    {
+        LOG_E("bad target range 0x%08x, %d bytes\n", (void *)dst, size);
+        return -SDK_E_INVALID;
+    }
+
+    op->w25qxx = w25qxx;
+    op->src = src;
+    op->dst = dst;
+    op->size = size;
+    op->crc = crc;
+    op->offset = 0;
+    op->crc_now = 0;
+    op->blocks = 0;
+    op->cur = 0;
+
+    if (stm32_settings_get(STM32_OTA_SETTINGS_KEY, &marker, sizeof(marker)) == sizeof(marker) &&
+        marker.src == src && marker.dst == dst && marker.size == size && marker.crc == crc &&
+        marker.offset < size && (marker.offset % STM32_OTA_BLOCK_SIZE) == 0)
+    {
+        LOG_I("resuming at %d of %d bytes\n", marker.offset, size);
+        op->offset = marker.offset;
+        op->crc_now = marker.crc_now;
+    }
+
+    return stm32_async_start(&op->async, ota_poll, done, param);
+}
+
+sdk_err_t stm32_ota_run(W25QXX_HandleTypeDef *w25qxx, uint32_t src, uint32_t dst, uint32_t size, uint32_t crc)
+{
+    stm32_ota_t op = {0};
+    sdk_err_t result;
+
+    result = stm32_ota_start(&op, w25qxx, src, dst, size, crc, NULL, NULL);
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+    /* stm32_async_wait would only step op, the block reads it waits on run alongside */
+    while (op.async.status == STM32_ASYNC_RUNNING)
+    {
+        stm32_async_step(&op.read.async);
+        stm32_async_step(&op.async);
+    }
+    return stm32_async_result(&op.async);
+}
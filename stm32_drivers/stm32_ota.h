@@ -0,0 +1,77 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_OTA_H
+#define __STM32_OTA_H
+
+#include "sdk_board.h"
+#include "stm32_async.h"
+#include "w25qxx.h"
+
+/*
+ * Firmware copy from the W25Qxx staging area into program flash. Blocks are
+ * read with SPI DMA into one buffer while the previous block is programmed
+ * from the other; the target pages of a block are erased right before it is
+ * written, so the old image stays whole up to the write pointer. Each block
+ * is CRC'd back from program flash (CRC unit) into an image CRC checked at
+ * the end, and the verified offset is saved in the settings store every few
+ * blocks, so a copy cut by a reset resumes there.
+ *
+ * stm32_settings_init must have run. The code doing the copy must not live
+ * in the target range, e.g. a bootloader.
+ */
+
+/* bytes per block, a multiple of the flash page size; two buffers of it in RAM */
+#ifndef STM32_OTA_BLOCK_SIZE
+#define STM32_OTA_BLOCK_SIZE        512
+#endif
+
+/* blocks between two progress markers */
+#ifndef STM32_OTA_MARKER_BLOCKS
+#define STM32_OTA_MARKER_BLOCKS     8
+#endif
+
+/* settings key of the progress marker */
+#ifndef STM32_OTA_SETTINGS_KEY
+#define STM32_OTA_SETTINGS_KEY      0xF00
+#endif
+
+typedef struct
+{
+    stm32_async_t async;
+    W25QXX_async_t read;        /* read of the next block */
+    W25QXX_HandleTypeDef *w25qxx;
+    uint32_t src;               /* image in the W25Qxx */
+    uint32_t dst;               /* page aligned in program flash */
+    uint32_t size;
+    uint32_t crc;               /* expected CRC-32 (IEEE) of the image */
+    uint32_t offset;            /* bytes programmed and CRC'd */
+    uint32_t crc_now;           /* CRC-32 of the first offset bytes */
+    uint32_t blocks;            /* since the last marker */
+    sdk_err_t error;            /* of the failed block, held while the prefetch ends */
+    uint8_t cur;                /* buffer holding the block at offset */
+} stm32_ota_t;
+
+/**
+  * @brief  Start or resume copying size bytes from src in the W25Qxx to dst.
+  * @note   Resumes from the saved marker when it was left by the same image.
+  * @retval SDK_OK, -SDK_E_INVALID for a bad range or when op is running
+  */
+sdk_err_t stm32_ota_start(stm32_ota_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t src, uint32_t dst, uint32_t size,
+                          uint32_t crc, stm32_async_done_t done, void *param);
+
+/**
+  * @brief  Blocking copy, see stm32_ota_start.
+  * @retval SDK_OK, -SDK_ERROR when a read, write or the image CRC fails
+  */
+sdk_err_t stm32_ota_run(W25QXX_HandleTypeDef *w25qxx, uint32_t src, uint32_t dst, uint32_t size, uint32_t crc);
+
+static inline uint32_t stm32_ota_progress(stm32_ota_t *op)
+{
+    return op->offset;
+}
+
+#endif
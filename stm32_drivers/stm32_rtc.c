@@ -8,10 +8,15 @@
 #include "aft_sdk.h"
 #include "sdk_board.h"
 #include "stm32l0xx_ll_lptim.h"
+#include "stm32_async.h"
+#include "stm32_common.h"
+#include "stm32_lowpower.h"
+#include "stm32_rtc.h"
 
 #define DBG_TAG "bsp.rtc"
 #define DBG_LVL DBG_LOG
 #include "sdk_log.h"
+#include "stm32_log.h"
 
 #define RTC_ERROR_NONE    0
 #define RTC_ERROR_TIMEOUT 1
@@ -46,64 +51,313 @@ uint32_t WaitForSynchro_RTC(void);
 
 static uint32_t lsi_freq = 0;
 
+/*
+ * LSI calibration runs in the background: LPTIM1 counts LSI/1 and its
+ * reload interrupts are timestamped with stm32_get_time_us, the counts
+ * already past the reload taking out the interrupt latency. After the
+ * window the correction goes to the smooth calibration (CALR), which the
+ * calendar takes without stopping; the prescalers are only rewritten when
+ * the error is beyond CALR's range. That stops the calendar and busy waits
+ * on INITF, so it is queued on the async loop rather than done in the
+ * LPTIM interrupt, and so is the warning for a run that was dropped.
+ */
+#define LSI_CAL_NOMINAL_HZ         37000
+#define LSI_CAL_PERIOD             9250    /* counts per reload, 1/4 s at the nominal LSI */
+#define LSI_CAL_PERIODS            4       /* measured reloads, after the one starting the window */
+#define LSI_CAL_MIN_HZ             26000
+#define LSI_CAL_MAX_HZ             56000
+/* a single period this far from the mean, in percent, means a missed or spurious reload */
+#define LSI_CAL_PERIOD_TOLERANCE   15
+/* calibrated prescalers: ck_apre = LSI/16, rounding PREDIV_S leaves at most 8 Hz, within the CALR range down to 26 kHz */
+#define LSI_CAL_ASYNCH_PREDIV      ((uint32_t)0x0F)
+
+static volatile uint8_t lsi_cal_busy;
+static uint8_t lsi_cal_count;
+static uint64_t lsi_cal_start_us;
+static uint64_t lsi_cal_last_us;
+static uint32_t lsi_cal_min_us;    /* shortest and longest single period of the window */
+static uint32_t lsi_cal_max_us;
+static uint64_t lsi_cal_mhz;       /* result left to the thread step */
+static uint8_t lsi_cal_dropped;
+static stm32_async_t lsi_cal_finish;
+
 static void MX_LPTIM1_Init(void)
 {
   LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_LPTIM1);
 
+  /* CFGR and IER are only writable while disabled */
+  LL_LPTIM_Disable(LPTIM1);
   LL_LPTIM_SetClockSource(LPTIM1, LL_LPTIM_CLK_SOURCE_INTERNAL);
   LL_LPTIM_SetPrescaler(LPTIM1, LL_LPTIM_PRESCALER_DIV1);
   LL_LPTIM_SetPolarity(LPTIM1, LL_LPTIM_OUTPUT_POLARITY_REGULAR);
   LL_LPTIM_SetUpdateMode(LPTIM1, LL_LPTIM_UPDATE_MODE_IMMEDIATE);
   LL_LPTIM_SetCounterMode(LPTIM1, LL_LPTIM_COUNTER_MODE_INTERNAL);
   LL_LPTIM_TrigSw(LPTIM1);
+  LL_LPTIM_DisableIT_CMPM(LPTIM1);
+  LL_LPTIM_EnableIT_ARRM(LPTIM1);
 
   LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM1_CLKSOURCE_LSI);
 }
 
 static void stm32lx_lptim_calibration(void)
 {
-    uint32_t delta_time = 0;
-    uint32_t lptim_freq = 0;
+    if (lsi_cal_busy)
+    {
+        return;
+    }
 
     MX_LPTIM1_Init();
-    
-    LL_LPTIM_EnableTimeout(LPTIM1);
+
     LL_LPTIM_Enable(LPTIM1);
     LL_LPTIM_ClearFlag_ARROK(LPTIM1);
-    LL_LPTIM_SetAutoReload(LPTIM1, 0xFFFF); /* 定时1秒,reload = 37000 / 32 = 1156 */
+    LL_LPTIM_SetAutoReload(LPTIM1, LSI_CAL_PERIOD - 1);
     while (!LL_LPTIM_IsActiveFlag_ARROK(LPTIM1))
         ;
 
-    LL_LPTIM_ClearFlag_CMPOK(LPTIM1);
-    LL_LPTIM_SetCompare(LPTIM1, 37000);
-    while (!LL_LPTIM_IsActiveFlag_CMPOK(LPTIM1))
-        ;
-    LL_LPTIM_StartCounter(LPTIM1, LL_LPTIM_OPERATING_MODE_ONESHOT);
- 
-    delta_time  = clock();
-    
-    while (!LL_LPTIM_IsActiveFlag_CMPM(LPTIM1))
+    lsi_cal_count = 0;
+    lsi_cal_busy = 1;
+    LL_LPTIM_ClearFLAG_ARRM(LPTIM1);
+    NVIC_EnableIRQ(LPTIM1_IRQn);
+    LL_LPTIM_StartCounter(LPTIM1, LL_LPTIM_OPERATING_MODE_CONTINUOUS);
+}
+
+/* PREDIV_A + 1 times PREDIV_S + 1, the RTCCLK cycles of one second */
+static uint32_t rtc_clock_divider(void)
+{
+    return (LL_RTC_GetAsynchPrescaler(RTC) + 1) * (LL_RTC_GetSynchPrescaler(RTC) + 1);
+}
+
+/*
+ * CALR adds 512 * CALP - CALM pulses per 2^20 RTCCLK cycles, so the second
+ * is exact when that is 2^20 * (divider - f) / f; CALP and CALM cover
+ * -511 .. +512 pulses, about -487 .. +488 ppm.
+ */
+static int32_t rtc_calibration_pulses(uint64_t lsi_mhz)
+{
+    return (int32_t)(((int64_t)rtc_clock_divider() * 1000 - (int64_t)lsi_mhz) * (1 << 20) / (int64_t)lsi_mhz);
+}
+
+static void rtc_write_calibration(int32_t pulses)
+{
+    if (pulses > 512)
+    {
+        pulses = 512;
+    }
+    else if (pulses < -511)
+    {
+        pulses = -511;
+    }
+
+    LL_RTC_DisableWriteProtection(RTC);
+    while (LL_RTC_IsActiveFlag_RECALP(RTC))
         ;
-    delta_time = clock() - delta_time;
- 
-    /* 计算lptim的实际频率 */
-    lptim_freq = (37000) * SDK_SYSTICK_PER_SECOND / delta_time;
-    lsi_freq = lptim_freq;
-    //disable
+    RTC->CALR = (pulses > 0) ? (RTC_CALR_CALP | (512 - pulses)) : (uint32_t)-pulses;
+    LL_RTC_EnableWriteProtection(RTC);
+}
+
+/* thread context, from stm32_async_poll: report a dropped run, or rewrite the prescalers for lsi_freq */
+static int32_t rtc_calibration_poll(stm32_async_t *op)
+{
+    (void)op;
+
+    if (lsi_cal_dropped)
+    {
+        LOG_W("lsi calibration dropped, %d mHz, periods %d .. %d us", (uint32_t)lsi_cal_mhz, lsi_cal_min_us, lsi_cal_max_us);
+        lsi_cal_dropped = 0;
+        lsi_cal_busy = 0;
+        return SDK_OK;
+    }
+    Configure_RTC();
+    rtc_write_calibration(rtc_calibration_pulses(lsi_cal_mhz));
+    LOG_D("lsi_freq = %d mHz, prescalers rewritten, calr = 0x%x", (uint32_t)lsi_cal_mhz, RTC->CALR);
+    lsi_cal_busy = 0;
+    return SDK_OK;
+}
+
+/* leave the rest to rtc_calibration_poll, calibrating until it has run */
+static void rtc_calibration_defer(uint64_t lsi_mhz)
+{
+    lsi_cal_mhz = lsi_mhz;
+    if (stm32_async_start(&lsi_cal_finish, rtc_calibration_poll, NULL, NULL) != SDK_OK)
+    {
+        lsi_cal_dropped = 0;
+        lsi_cal_busy = 0;
+    }
+}
+
+/* the counter runs on LSI, a read is only valid when two agree */
+static uint32_t lsi_cal_counter(void)
+{
+    uint32_t a;
+    uint32_t b = LL_LPTIM_GetCounter(LPTIM1);
+
+    do
+    {
+        a = b;
+        b = LL_LPTIM_GetCounter(LPTIM1);
+    } while (a != b);
+
+    return a;
+}
+
+void stm32_lptim_reload_callback(void)
+{
+    uint64_t now = stm32_get_time_us();
+    uint32_t late = lsi_cal_counter();
+    uint32_t period_us;
+    uint32_t mean_us;
+    uint64_t lsi_mhz;
+    int32_t pulses;
+
+    if (!lsi_cal_busy)
+    {
+        return;
+    }
+
+    /* time of the reload itself, at the nominal rate; late is a few counts unless interrupts were masked */
+    now -= (uint64_t)late * 1000000 / LSI_CAL_NOMINAL_HZ;
+    if (lsi_cal_count++ == 0)
+    {
+        lsi_cal_start_us = now;
+        lsi_cal_last_us = now;
+        lsi_cal_min_us = 0xFFFFFFFF;
+        lsi_cal_max_us = 0;
+        return;
+    }
+    period_us = (uint32_t)(now - lsi_cal_last_us);
+    lsi_cal_last_us = now;
+    if (period_us < lsi_cal_min_us)
+    {
+        lsi_cal_min_us = period_us;
+    }
+    if (period_us > lsi_cal_max_us)
+    {
+        lsi_cal_max_us = period_us;
+    }
+    if (lsi_cal_count <= LSI_CAL_PERIODS)
+    {
+        return;
+    }
+
     LL_LPTIM_Disable(LPTIM1);
-    LOG_D("lsi_freq = %d, delta_time = %d", lsi_freq, delta_time);
+    LL_LPTIM_DisableIT_ARRM(LPTIM1);
+
+    /*
+     * A reload missed while interrupts were masked makes one period twice
+     * the others, which the aggregate alone hides: with 4 periods a 37 kHz
+     * LSI would read as 29.6 kHz, inside the datasheet range. So every
+     * period must be close to the mean, and the mean within that range.
+     */
+    mean_us = (uint32_t)((now - lsi_cal_start_us) / LSI_CAL_PERIODS);
+    lsi_mhz = (uint64_t)LSI_CAL_PERIOD * LSI_CAL_PERIODS * 1000000000ULL / (now - lsi_cal_start_us);
+    if ((uint64_t)lsi_cal_max_us * 100 > (uint64_t)mean_us * (100 + LSI_CAL_PERIOD_TOLERANCE) ||
+        (uint64_t)lsi_cal_min_us * 100 < (uint64_t)mean_us * (100 - LSI_CAL_PERIOD_TOLERANCE) ||
+        lsi_mhz < LSI_CAL_MIN_HZ * 1000ULL || lsi_mhz > LSI_CAL_MAX_HZ * 1000ULL)
+    {
+        lsi_cal_dropped = 1;
+        rtc_calibration_defer(lsi_mhz);
+        return;
+    }
+    lsi_freq = (uint32_t)((lsi_mhz + 500) / 1000);
+    stm32_tickless_set_clock(lsi_freq);
+
+    pulses = rtc_calibration_pulses(lsi_mhz);
+    if (pulses > 512 || pulses < -511)
+    {
+        rtc_calibration_defer(lsi_mhz);
+        return;
+    }
+    rtc_write_calibration(pulses);
+    lsi_cal_busy = 0;
+}
+
+void stm32_rtc_calibrate(void)
+{
+#ifdef SDK_RTC_CLOCK_SELECT_LSI
+    stm32lx_lptim_calibration();
+#endif
+}
+
+uint8_t stm32_rtc_calibrating(void)
+{
+    return lsi_cal_busy;
+}
+
+/*
+ * Reading SSR or TR freezes the shadow DR until DR is read, so the three
+ * are read in that order and belong to the same second. Without shadow
+ * registers the read is repeated until two agree.
+ */
+static void rtc_read(uint32_t *ssr, uint32_t *tr, uint32_t *dr)
+{
+    uint32_t again;
+
+    do
+    {
+        *ssr = RTC->SSR;
+        *tr = RTC->TR;
+        *dr = RTC->DR;
+        again = (RTC->CR & RTC_CR_BYPSHAD) && (RTC->SSR != *ssr || RTC->TR != *tr || RTC->DR != *dr);
+    } while (again);
+}
+
+uint32_t stm32_rtc_get_time(void)
+{
+    uint32_t ssr, tr, dr;
+
+    rtc_read(&ssr, &tr, &dr);
+
+    return stm32_rtc_unix_time(tr, dr);
+}
+
+/* 2^32 / (PREDIV_S + 1), redone only when Configure_RTC changed the prescaler */
+static uint32_t rtc_subsec_prediv = 0xFFFFFFFF;
+static uint32_t rtc_subsec_scale;
+
+void stm32_rtc_get_time_subsec(stm32_rtc_time_t *time)
+{
+    uint32_t ssr, tr, dr;
+    uint32_t prediv;
+    int32_t counts;
+
+    rtc_read(&ssr, &tr, &dr);
+    prediv = LL_RTC_GetSynchPrescaler(RTC);
+    if (prediv != rtc_subsec_prediv)
+    {
+        rtc_subsec_scale = (uint32_t)(0x100000000ULL / (prediv + 1));
+        rtc_subsec_prediv = prediv;
+    }
+
+    /* SSR counts down from PREDIV_S, above it only after a shift and then TR is a second ahead */
+    time->sec = stm32_rtc_unix_time(tr, dr);
+    counts = (int32_t)prediv - (int32_t)ssr;
+    if (counts < 0)
+    {
+        time->sec--;
+        counts += prediv + 1;
+        if (counts < 0)
+        {
+            counts = 0;
+        }
+    }
+
+    time->frac = (uint16_t)(((uint64_t)counts * rtc_subsec_scale) >> 16);
+    time->msec = (uint16_t)((time->frac * 1000UL) >> 16);
 }
 
 static time_t get_rtc_timestamp(void)
 {
-    struct tm tm_new;
+    struct tm tm_new = {0};
+    uint32_t ssr, tr, dr;
 
-    tm_new.tm_sec  = bcd2dec(LL_RTC_TIME_GetSecond(RTC));
-    tm_new.tm_min  = bcd2dec(LL_RTC_TIME_GetMinute(RTC));
-    tm_new.tm_hour = bcd2dec(LL_RTC_TIME_GetHour(RTC));
-    tm_new.tm_mday = bcd2dec(LL_RTC_DATE_GetDay(RTC));
-    tm_new.tm_mon  = bcd2dec(LL_RTC_DATE_GetMonth(RTC)) - 1;
-    tm_new.tm_year = bcd2dec(LL_RTC_DATE_GetYear(RTC)) + 100;
+    rtc_read(&ssr, &tr, &dr);
+
+    tm_new.tm_sec  = stm32_rtc_bcd((tr & (RTC_TR_ST | RTC_TR_SU)) >> RTC_TR_SU_Pos);
+    tm_new.tm_min  = stm32_rtc_bcd((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos);
+    tm_new.tm_hour = stm32_rtc_bcd((tr & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos);
+    tm_new.tm_mday = stm32_rtc_bcd((dr & (RTC_DR_DT | RTC_DR_DU)) >> RTC_DR_DU_Pos);
+    tm_new.tm_mon  = stm32_rtc_bcd((dr & (RTC_DR_MT | RTC_DR_MU)) >> RTC_DR_MU_Pos) - 1;
+    tm_new.tm_year = stm32_rtc_bcd((dr & (RTC_DR_YT | RTC_DR_YU)) >> RTC_DR_YU_Pos) + 100;
 
     return mktime(&tm_new);
 }
@@ -195,6 +449,14 @@ static sdk_err_t stm32_rtc_control(sdk_rtc_t *rtc, int32_t cmd, void *args)
         *(uint32_t *)args = get_rtc_timestamp();
         break;
 
+    case STM32_CONTROL_RTC_GET_TIME_FAST:
+        *(uint32_t *)args = stm32_rtc_get_time();
+        break;
+
+    case STM32_CONTROL_RTC_GET_TIME_SUBSEC:
+        stm32_rtc_get_time_subsec((stm32_rtc_time_t *)args);
+        break;
+
     case SDK_CONTROL_RTC_SET_TIME:
         if (set_rtc_timestamp(*(uint32_t *)args))
         {
@@ -252,10 +514,7 @@ static sdk_err_t stm32_rtc_control(sdk_rtc_t *rtc, int32_t cmd, void *args)
         break;
     }
     case SDK_CONTROL_RTC_CALIBRATION:
-#ifdef SDK_RTC_CLOCK_SELECT_LSI
-        stm32lx_lptim_calibration();
-        Configure_RTC();
-#endif
+        stm32_rtc_calibrate();
         break;
     default:
         return -(SDK_E_INVALID);
@@ -294,10 +553,10 @@ void Configure_RTC(void)
   LL_RTC_SetHourFormat(RTC, LL_RTC_HOURFORMAT_24HOUR);
 
   if(lsi_freq > 0)
-  {/* ck_apre=LSIFreq/(ASYNC prediv + 1) with LSIFreq=37 kHz RC */
-/* ck_spre=ck_apre/(SYNC prediv + 1) = 1 Hz */
-      uint32_t async_prediv = 0x7F;
-      uint32_t sync_prediv = lsi_freq / (async_prediv + 1) - 1;
+  {/* ck_apre=LSIFreq/(ASYNC prediv + 1) with the measured LSIFreq */
+/* ck_spre=ck_apre/(SYNC prediv + 1) = 1 Hz, the rounding error is left to CALR */
+      uint32_t async_prediv = LSI_CAL_ASYNCH_PREDIV;
+      uint32_t sync_prediv = (lsi_freq + (async_prediv + 1) / 2) / (async_prediv + 1) - 1;
       /* Set Asynch Prediv (value according to source clock) */
       LL_RTC_SetAsynchPrescaler(RTC, async_prediv);
       /* Set Synch Prediv (value according to source clock) */
@@ -468,9 +727,6 @@ static sdk_err_t stm32_rtc_open(sdk_rtc_t *rtc)
 {
     if (LL_RTC_BAK_GetRegister(RTC, LL_RTC_BKP_DR1) != RTC_BKP_DATE_TIME_UPDTATED)
     {
-#ifdef SDK_RTC_CLOCK_SELECT_LSI
-        stm32lx_lptim_calibration();
-#endif
         Configure_RTC();
         Configure_RTC_Calendar();
         LOG_D("rtc_setup....\n\r");
@@ -483,6 +739,8 @@ static sdk_err_t stm32_rtc_open(sdk_rtc_t *rtc)
         exti_flag_clear(EXTI_17);
 #endif
     }
+    /* finishes in the background, about 1.25 s later */
+    stm32_rtc_calibrate();
 #if defined(RT_USING_ALARM)
     /* RTC alarm interrupt configuration */
     exti_init(EXTI_17, EXTI_INTERRUPT, EXTI_TRIG_RISING);
@@ -0,0 +1,90 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_RTC_H
+#define __STM32_RTC_H
+
+#include "sdk_board.h"
+#include "sdk_rtc.h"
+
+#define STM32_CONTROL_RTC_BASE              0x80
+#define STM32_CONTROL_RTC_GET_TIME_FAST     (STM32_CONTROL_RTC_BASE + 0)  /* args: uint32_t *, UTC seconds */
+#define STM32_CONTROL_RTC_GET_TIME_SUBSEC   (STM32_CONTROL_RTC_BASE + 1)  /* args: stm32_rtc_time_t * */
+
+typedef struct
+{
+    uint32_t sec;           /* as stm32_rtc_get_time */
+    uint16_t frac;          /* of the second, in 1/65536 */
+    uint16_t msec;
+} stm32_rtc_time_t;
+
+static inline uint32_t stm32_rtc_bcd(uint32_t bcd)
+{
+    return (bcd >> 4) * 10 + (bcd & 0xF);
+}
+
+/* days before each month of a common year */
+static const uint16_t stm32_rtc_month_days[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/* days from 1970-01-01 to 20yy-mm-dd, the years the RTC holds; no division, the M0+ has no divider */
+static inline uint32_t stm32_rtc_days_from_civil(uint32_t year, uint32_t month, uint32_t day)
+{
+    uint32_t days = 10957 + year * 365 + ((year + 3) >> 2) + stm32_rtc_month_days[month - 1] + day - 1;
+
+    if ((year & 3) == 0 && month > 2)
+    {
+        days++;
+    }
+    return days;
+}
+
+/**
+  * @brief  Unix time of RTC_TR and RTC_DR values read together.
+  * @note   Inline, so tools/rtc_bench.c measures this very code against mktime.
+  */
+static inline uint32_t stm32_rtc_unix_time(uint32_t tr, uint32_t dr)
+{
+    uint32_t days;
+
+    days = stm32_rtc_days_from_civil(stm32_rtc_bcd((dr & (RTC_DR_YT | RTC_DR_YU)) >> RTC_DR_YU_Pos),
+                                     stm32_rtc_bcd((dr & (RTC_DR_MT | RTC_DR_MU)) >> RTC_DR_MU_Pos),
+                                     stm32_rtc_bcd((dr & (RTC_DR_DT | RTC_DR_DU)) >> RTC_DR_DU_Pos));
+
+    return ((days * 24 + stm32_rtc_bcd((tr & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos)) * 60 +
+            stm32_rtc_bcd((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos)) * 60 +
+           stm32_rtc_bcd((tr & (RTC_TR_ST | RTC_TR_SU)) >> RTC_TR_SU_Pos);
+}
+
+/**
+  * @brief  Unix time of the calendar, the RTC holding UTC.
+  * @note   One coherent register read and integer date math, no mktime:
+  *         cheap enough for every log record. SDK_CONTROL_RTC_GET_TIME
+  *         still goes through mktime and the local time zone.
+  */
+uint32_t stm32_rtc_get_time(void);
+
+/**
+  * @brief  Time with the fraction of the second from RTC_SSR.
+  * @note   The resolution is one tick of ck_apre, 1/(PREDIV_S + 1) s: about
+  *         4 ms with the default prescalers, under 1 ms once the LSI
+  *         calibration has rewritten them.
+  */
+void stm32_rtc_get_time_subsec(stm32_rtc_time_t *time);
+
+/**
+  * @brief  Start measuring the LSI in the background, as SDK_CONTROL_RTC_CALIBRATION.
+  * @note   Takes about 1.25 s of LPTIM1, tickless idle only sleeps after it.
+  *         The result goes to the smooth calibration, and to the prescalers
+  *         only when it is beyond the CALR range; that rewrite stops the
+  *         calendar, so it runs on the next stm32_async_poll, as does the
+  *         warning for a dropped run, and stm32_rtc_calibrating stays set
+  *         until then. No effect with the LSE.
+  */
+void stm32_rtc_calibrate(void);
+
+uint8_t stm32_rtc_calibrating(void);
+
+#endif
@@ -0,0 +1,408 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "sdk_flash.h"
+#include "stm32_flash.h"
+#include "stm32_settings.h"
+
+#define DBG_LVL DBG_LOG
+#define DBG_TAG "mcu.settings"
+#include "sdk_log.h"
+#include "stm32_log.h"
+
+/* bank header: magic, then a sequence number, the higher one is active */
+#define SETTINGS_BANK_MAGIC         0x53455454UL
+#define SETTINGS_BANK_HEADER        8
+
+/*
+ * Record: header word magic(4) key(12) len(8) check(8), the data padded to
+ * words, then a CRC-32 of key, len and data. The CRC word is programmed last
+ * and commits the record.
+ */
+#define SETTINGS_REC_MAGIC          0xAUL
+#define SETTINGS_REC(key, len)      ((SETTINGS_REC_MAGIC << 28) | ((uint32_t)(key) << 16) | ((uint32_t)(len) << 8))
+#define SETTINGS_REC_KEY(h)         (((h) >> 16) & 0xFFF)
+#define SETTINGS_REC_LEN(h)         (((h) >> 8) & 0xFF)
+#define SETTINGS_REC_CHECK(h)       ((h) & 0xFF)
+#define SETTINGS_REC_DATA(len)      (((len) + 3) & ~3UL)
+#define SETTINGS_REC_SIZE(len)      (8 + SETTINGS_REC_DATA(len))
+
+#define SETTINGS_BANK_ADDR(bank)    (STM32_SETTINGS_ADDRESS + (bank) * STM32_SETTINGS_BANK_SIZE)
+
+/* the index keeps record offsets in 16 bits */
+#if STM32_SETTINGS_BANK_SIZE > 0x10000
+#error "STM32_SETTINGS_BANK_SIZE must not exceed 64 KB"
+#endif
+
+struct settings_index
+{
+    uint16_t key;
+    uint16_t offset;            /* of the latest record in the active bank */
+};
+
+static struct settings_index settings_index[STM32_SETTINGS_MAX_KEYS];
+static uint32_t settings_keys;
+static uint8_t settings_bank;
+static uint32_t settings_seq;
+static uint32_t settings_tail;  /* append offset in the active bank */
+static uint8_t settings_dropped;    /* the bank holds keys the index has no room for */
+
+/* CRC-32 (IEEE), bitwise: records are short and a table costs 1 KB of flash */
+static uint32_t settings_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    uint32_t i;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t settings_rec_header(uint16_t key, size_t len)
+{
+    uint8_t head[3] = {(uint8_t)key, (uint8_t)(key >> 8), (uint8_t)len};
+
+    return SETTINGS_REC(key, len) | (settings_crc32(0, head, sizeof(head)) & 0xFF);
+}
+
+static uint32_t settings_rec_crc(uint32_t header, const uint8_t *data, size_t len)
+{
+    return settings_crc32(settings_crc32(0, (const uint8_t *)&header, 4), data, len);
+}
+
+static uint32_t settings_word(uint8_t bank, uint32_t offset)
+{
+    return *(const uint32_t *)(SETTINGS_BANK_ADDR(bank) + offset);
+}
+
+static sdk_err_t settings_program(uint32_t addr, const void *data, size_t len)
+{
+    int32_t ret = stm32_onchip_flash.ops.write(&stm32_onchip_flash, addr, data, len);
+
+    return ret < 0 ? ret : SDK_OK;
+}
+
+static struct settings_index *settings_find(uint16_t key)
+{
+    uint32_t i;
+
+    for (i = 0; i < settings_keys; i++)
+    {
+        if (settings_index[i].key == key)
+        {
+            return &settings_index[i];
+        }
+    }
+    return NULL;
+}
+
+static sdk_err_t settings_index_set(uint16_t key, uint32_t offset)
+{
+    struct settings_index *entry = settings_find(key);
+
+    if (entry == NULL)
+    {
+        if (settings_keys >= STM32_SETTINGS_MAX_KEYS)
+        {
+            LOG_E("index full, key 0x%03x dropped\n", key);
+            return -SDK_E_INVALID;
+        }
+        entry = &settings_index[settings_keys++];
+        entry->key = key;
+    }
+    entry->offset = offset;
+    return SDK_OK;
+}
+
+static uint8_t settings_bank_valid(uint8_t bank)
+{
+    return settings_word(bank, 0) == SETTINGS_BANK_MAGIC;
+}
+
+/*
+ * Rebuild the index from the log. A record cut by a reset after its header
+ * fails its CRC and is skipped; a header that was cut itself ends the scan
+ * and marks the bank full, so the next write compacts past it. Keys beyond
+ * STM32_SETTINGS_MAX_KEYS, e.g. left by a build with a larger index, fail
+ * the scan: a compaction would lose them for good.
+ */
+static sdk_err_t settings_scan(void)
+{
+    uint32_t offset = SETTINGS_BANK_HEADER;
+
+    settings_keys = 0;
+    settings_dropped = 0;
+    while (offset + 4 <= STM32_SETTINGS_BANK_SIZE)
+    {
+        uint32_t header = settings_word(settings_bank, offset);
+        uint32_t len;
+
+        if (header == STM32_FLASH_ERASED_WORD)
+        {
+            break;
+        }
+        len = SETTINGS_REC_LEN(header);
+        if (header != settings_rec_header(SETTINGS_REC_KEY(header), len) ||
+            offset + SETTINGS_REC_SIZE(len) > STM32_SETTINGS_BANK_SIZE)
+        {
+            LOG_W("bad record at 0x%08x\n", (void *)(SETTINGS_BANK_ADDR(settings_bank) + offset));
+            offset = STM32_SETTINGS_BANK_SIZE;
+            break;
+        }
+        if (settings_rec_crc(header, (const uint8_t *)(SETTINGS_BANK_ADDR(settings_bank) + offset + 4), len) ==
+            settings_word(settings_bank, offset + 4 + SETTINGS_REC_DATA(len)))
+        {
+            if (settings_index_set(SETTINGS_REC_KEY(header), offset) != SDK_OK)
+            {
+                settings_dropped = 1;
+            }
+        }
+        offset += SETTINGS_REC_SIZE(len);
+    }
+    settings_tail = offset;
+
+    return settings_dropped ? -SDK_E_INVALID : SDK_OK;
+}
+
+/* deleted keys keep their index slot until a compaction */
+static uint8_t settings_has_deleted(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < settings_keys; i++)
+    {
+        if (SETTINGS_REC_LEN(settings_word(settings_bank, settings_index[i].offset)) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* the spare bank becomes active once its magic word is programmed, last */
+static sdk_err_t settings_bank_commit(uint8_t bank, uint32_t seq)
+{
+    uint32_t magic = SETTINGS_BANK_MAGIC;
+    sdk_err_t result;
+
+    result = settings_program(SETTINGS_BANK_ADDR(bank) + 4, &seq, 4);
+    if (result == SDK_OK)
+    {
+        result = settings_program(SETTINGS_BANK_ADDR(bank), &magic, 4);
+    }
+    return result;
+}
+
+static sdk_err_t settings_erase_bank(uint8_t bank)
+{
+    sdk_err_t result;
+
+    result = stm32_onchip_flash.ops.erase(&stm32_onchip_flash, SETTINGS_BANK_ADDR(bank), STM32_SETTINGS_BANK_SIZE);
+    return result < 0 ? result : SDK_OK;
+}
+
+/* copy the live records into the spare bank and switch to it */
+static sdk_err_t settings_compact(void)
+{
+    uint8_t spare = settings_bank ^ 1;
+    uint32_t offset = SETTINGS_BANK_HEADER;
+    sdk_err_t result;
+    uint32_t i;
+
+    if (settings_dropped)
+    {
+        LOG_E("keys beyond the index, not compacting\n");
+        return -SDK_E_INVALID;
+    }
+
+    /* may hold an earlier compaction cut by a reset */
+    result = settings_erase_bank(spare);
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+
+    for (i = 0; i < settings_keys; i++)
+    {
+        uint32_t src = SETTINGS_BANK_ADDR(settings_bank) + settings_index[i].offset;
+        uint32_t size = SETTINGS_REC_SIZE(SETTINGS_REC_LEN(*(const uint32_t *)src));
+
+        /* deleted keys are left behind */
+        if (SETTINGS_REC_LEN(*(const uint32_t *)src) == 0)
+        {
+            continue;
+        }
+        result = settings_program(SETTINGS_BANK_ADDR(spare) + offset, (const void *)src, size);
+        if (result != SDK_OK)
+        {
+            return result;
+        }
+        offset += size;
+    }
+
+    result = settings_bank_commit(spare, settings_seq + 1);
+    if (result != SDK_OK)
+    {
+        return result;
+    }
+
+    LOG_D("compacted into bank %d, %d bytes live\n", spare, offset);
+    settings_bank = spare;
+    settings_seq++;
+    settings_scan();
+
+    /* the old bank only matters until the commit above */
+    return settings_erase_bank(spare ^ 1);
+}
+
+sdk_err_t stm32_settings_init(void)
+{
+    uint8_t valid0 = settings_bank_valid(0);
+    uint8_t valid1 = settings_bank_valid(1);
+    sdk_err_t result;
+
+    if (valid0 && valid1)
+    {
+        settings_bank = ((int32_t)(settings_word(1, 4) - settings_word(0, 4)) > 0) ? 1 : 0;
+    }
+    else if (valid0 || valid1)
+    {
+        settings_bank = valid1;
+    }
+    else
+    {
+        LOG_I("no settings bank, formatting\n");
+        result = settings_erase_bank(0);
+        if (result == SDK_OK)
+        {
+            result = settings_bank_commit(0, 1);
+        }
+        if (result != SDK_OK)
+        {
+            return result;
+        }
+        settings_bank = 0;
+    }
+
+    settings_seq = settings_word(settings_bank, 4);
+    result = settings_scan();
+    if (result != SDK_OK)
+    {
+        LOG_E("more than %d keys stored, raise STM32_SETTINGS_MAX_KEYS\n", STM32_SETTINGS_MAX_KEYS);
+    }
+
+    return result;
+}
+
+int32_t stm32_settings_get(uint16_t key, void *buf, size_t size)
+{
+    struct settings_index *entry = settings_find(key);
+    uint32_t addr;
+    uint32_t len;
+
+    if (entry == NULL)
+    {
+        return 0;
+    }
+
+    addr = SETTINGS_BANK_ADDR(settings_bank) + entry->offset;
+    len = SETTINGS_REC_LEN(*(const uint32_t *)addr);
+    memcpy(buf, (const void *)(addr + 4), len < size ? len : size);
+
+    return len;
+}
+
+sdk_err_t stm32_settings_set(uint16_t key, const void *data, size_t len)
+{
+    struct settings_index *entry;
+    uint32_t header;
+    uint32_t addr;
+    uint32_t crc;
+    sdk_err_t result;
+
+    if (key > STM32_SETTINGS_KEY_MAX || len > STM32_SETTINGS_LEN_MAX || (data == NULL && len != 0))
+    {
+        return -SDK_E_INVALID;
+    }
+
+    entry = settings_find(key);
+    if (entry != NULL)
+    {
+        uint32_t cur = SETTINGS_BANK_ADDR(settings_bank) + entry->offset;
+
+        if (SETTINGS_REC_LEN(*(const uint32_t *)cur) == len && (len == 0 || memcmp((const void *)(cur + 4), data, len) == 0))
+        {
+            return SDK_OK;
+        }
+    }
+    else if (len == 0)
+    {
+        return SDK_OK;
+    }
+    else if (settings_keys >= STM32_SETTINGS_MAX_KEYS)
+    {
+        if (!settings_has_deleted())
+        {
+            return -SDK_E_INVALID;
+        }
+        result = settings_compact();
+        if (result != SDK_OK)
+        {
+            return result;
+        }
+    }
+
+    if (settings_tail + SETTINGS_REC_SIZE(len) > STM32_SETTINGS_BANK_SIZE)
+    {
+        result = settings_compact();
+        if (result != SDK_OK)
+        {
+            return result;
+        }
+        if (settings_tail + SETTINGS_REC_SIZE(len) > STM32_SETTINGS_BANK_SIZE)
+        {
+            LOG_E("settings full, key 0x%03x not written\n", key);
+            return -SDK_E_INVALID;
+        }
+    }
+
+    /* header first, so the scan knows the length of a record cut short; the CRC word last */
+    addr = SETTINGS_BANK_ADDR(settings_bank) + settings_tail;
+    header = settings_rec_header(key, len);
+    crc = settings_rec_crc(header, data, len);
+    result = settings_program(addr, &header, 4);
+    if (result == SDK_OK && len != 0)
+    {
+        result = settings_program(addr + 4, data, len);
+    }
+    if (result == SDK_OK)
+    {
+        result = settings_program(addr + 4 + SETTINGS_REC_DATA(len), &crc, 4);
+    }
+    if (result != SDK_OK)
+    {
+        /* the words may be half programmed, leave them to the next compaction */
+        settings_tail = STM32_SETTINGS_BANK_SIZE;
+        return result;
+    }
+
+    result = settings_index_set(key, settings_tail);
+    settings_tail += SETTINGS_REC_SIZE(len);
+
+    return result;
+}
+
+sdk_err_t stm32_settings_delete(uint16_t key)
+{
+    return stm32_settings_set(key, NULL, 0);
+}
@@ -0,0 +1,73 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_SETTINGS_H
+#define __STM32_SETTINGS_H
+
+#include "sdk_board.h"
+
+/*
+ * Settings store on stm32_onchip_flash. Two banks take turns: the active
+ * one is an append only log of records (12 bit key, up to 255 bytes, CRC),
+ * the last record of a key wins, and a RAM index points at it. A write is
+ * a header word, the data words and a CRC word; only when the active bank
+ * is full are the live records copied into the spare bank, which becomes
+ * active once its header is written. A reset at any point leaves either the old or the new
+ * value, found again by the scan in stm32_settings_init; tools/settings_powerfail.c
+ * checks this on the host.
+ *
+ * Call it from the main loop only, writes program flash and are not reentrant.
+ */
+
+/* pages per bank, an L0 page is only 128 bytes; at most 64 KB a bank */
+#ifndef STM32_SETTINGS_BANK_PAGES
+#define STM32_SETTINGS_BANK_PAGES   8
+#endif
+#define STM32_SETTINGS_BANK_SIZE    (STM32_SETTINGS_BANK_PAGES * MCU_FLASH_PAGE_SIZE)
+
+/* both banks, page aligned, at the end of program flash by default */
+#ifndef STM32_SETTINGS_ADDRESS
+#define STM32_SETTINGS_ADDRESS      (MCU_FLASH_END_ADDRESS - 2 * STM32_SETTINGS_BANK_SIZE)
+#endif
+
+/* distinct keys held by the RAM index */
+#ifndef STM32_SETTINGS_MAX_KEYS
+#define STM32_SETTINGS_MAX_KEYS     32
+#endif
+
+#define STM32_SETTINGS_KEY_MAX      0xFFF
+#define STM32_SETTINGS_LEN_MAX      255
+
+/**
+  * @brief  Find the active bank and build the index, formats the store when
+  *         neither bank is valid.
+  * @retval SDK_OK, -SDK_E_INVALID when the bank holds more keys than
+  *         STM32_SETTINGS_MAX_KEYS: the indexed ones still read, but writes
+  *         that need a compaction fail rather than drop the others
+  */
+sdk_err_t stm32_settings_init(void);
+
+/**
+  * @brief  Copy the value of key into buf, at most size bytes.
+  * @retval Length of the stored value, 0 when the key is not set
+  */
+int32_t stm32_settings_get(uint16_t key, void *buf, size_t size);
+
+/**
+  * @brief  Store a value, nothing is written when it is unchanged.
+  * @retval SDK_OK, -SDK_E_INVALID for a bad key or length, or when the live
+  *         records no longer fit a bank or the index
+  * @note   A new key with the index full compacts first when deleted keys
+  *         still hold slots.
+  */
+sdk_err_t stm32_settings_set(uint16_t key, const void *data, size_t len);
+
+/**
+  * @brief  Remove a key, stored as an empty record until the next compaction.
+  */
+sdk_err_t stm32_settings_delete(uint16_t key);
+
+#endif
@@ -6,10 +6,12 @@
 
 #include "sdk_board.h"
 #include "sdk_swi2c.h"
+#include "stm32_common.h"
 
 //#define DBG_LVL DBG_LOG
 #define LOG_TAG              "swi2c"
 #include "sdk_log.h"
+#include "stm32_log.h"
 
 
 static void stm32_i2c_gpio_init(void)
@@ -57,7 +59,14 @@ static int32_t stm32_get_scl(void *data)
 
 static void stm32_udelay(uint32_t us)
 {
-    sdk_hw_us_delay(us);
+    if (us <= STM32_DELAY_LOOP_MAX_US && stm32_delay_loops_per_us_q16 != 0)
+    {
+        stm32_delay_us(us);
+    }
+    else
+    {
+        sdk_hw_us_delay(us);
+    }
 }
 
 static sdk_err_t stm32_i2c_unlock(void)
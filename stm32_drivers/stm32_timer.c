@@ -0,0 +1,289 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "stm32_common.h"
+#include "stm32_timer.h"
+
+/*
+ * Four levels of 64 slots. Level 0 holds the timers due within 64 ticks, one
+ * slot per tick; level n holds 64^n ticks per slot and is cascaded down one
+ * level each time the level below wraps. Timers further than 2^24 ticks away
+ * park in the last level and are re-queued as it cascades.
+ */
+#define TIMER_LEVELS        4
+#define TIMER_SLOT_BITS     6
+#define TIMER_SLOTS         (1UL << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK     (TIMER_SLOTS - 1)
+#define TIMER_MAX_DELTA     ((1UL << (TIMER_LEVELS * TIMER_SLOT_BITS)) - 1)
+
+static stm32_timer_t *timer_wheel[TIMER_LEVELS][TIMER_SLOTS];
+static uint64_t timer_bitmap[TIMER_LEVELS];     /* non empty slots */
+static uint32_t timer_jiffies;                  /* next tick to process */
+
+static void timer_link(stm32_timer_t **head, stm32_timer_t *timer)
+{
+    timer->next = *head;
+    if (*head != NULL)
+    {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void timer_unlink(stm32_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+    if (timer_wheel[timer->level][timer->slot] == NULL)
+    {
+        timer_bitmap[timer->level] &= ~(1ULL << timer->slot);
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+static void timer_enqueue(stm32_timer_t *timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - timer_jiffies;
+    uint32_t level;
+
+    if ((int32_t)delta < 0)
+    {
+        /* already due, runs on the next tick */
+        expires = timer_jiffies;
+        delta = 0;
+    }
+    else if (delta > TIMER_MAX_DELTA)
+    {
+        expires = timer_jiffies + TIMER_MAX_DELTA;
+        delta = TIMER_MAX_DELTA;
+    }
+
+    for (level = 0; level < TIMER_LEVELS - 1; level++)
+    {
+        if (delta < (1UL << ((level + 1) * TIMER_SLOT_BITS)))
+        {
+            break;
+        }
+    }
+
+    timer->level = level;
+    timer->slot = (expires >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+    timer_link(&timer_wheel[level][timer->slot], timer);
+    timer_bitmap[level] |= 1ULL << timer->slot;
+}
+
+static uint32_t timer_cascade(uint32_t level, uint32_t slot)
+{
+    stm32_timer_t *list = timer_wheel[level][slot];
+
+    timer_wheel[level][slot] = NULL;
+    timer_bitmap[level] &= ~(1ULL << slot);
+    while (list != NULL)
+    {
+        stm32_timer_t *next = list->next;
+        timer_enqueue(list);
+        list = next;
+    }
+
+    return slot;
+}
+
+/* offset of the first non empty slot at or after 'from', circularly, or -1 */
+static int32_t timer_bitmap_next(uint32_t level, uint32_t from)
+{
+    uint64_t bits = timer_bitmap[level];
+
+    if (from != 0)
+    {
+        bits = (bits >> from) | (bits << (TIMER_SLOTS - from));
+    }
+    if (bits == 0)
+    {
+        return -1;
+    }
+    return __builtin_ctzll(bits);
+}
+
+void stm32_timer_init(stm32_timer_t *timer, void (*callback)(stm32_timer_t *timer, void *param), void *param)
+{
+    memset(timer, 0, sizeof(stm32_timer_t));
+    timer->callback = callback;
+    timer->param = param;
+}
+
+/**
+  * @brief  Arm a timer, re-arming it if it is already running.
+  * @param  ticks: systicks until the first expiry, 0 behaves as 1
+  * @param  period: reload in systicks, 0 for a one shot timer
+  */
+void stm32_timer_start(stm32_timer_t *timer, uint32_t ticks, uint32_t period)
+{
+    stm32_critical_t state;
+
+    if (ticks == 0)
+    {
+        ticks = 1;
+    }
+
+    state = stm32_critical_enter();
+    if (timer->pprev != NULL)
+    {
+        timer_unlink(timer);
+    }
+    timer->expires = timer_jiffies + ticks - 1;
+    timer->period = period;
+    timer_enqueue(timer);
+    stm32_critical_exit(state);
+}
+
+void stm32_timer_stop(stm32_timer_t *timer)
+{
+    stm32_critical_t state;
+
+    state = stm32_critical_enter();
+    if (timer->pprev != NULL)
+    {
+        timer_unlink(timer);
+    }
+    stm32_critical_exit(state);
+}
+
+uint8_t stm32_timer_is_active(stm32_timer_t *timer)
+{
+    return timer->pprev != NULL;
+}
+
+uint32_t stm32_timer_next_expiry(void)
+{
+    uint32_t next = STM32_TIMER_NEVER;
+    stm32_critical_t state;
+    uint32_t level;
+    int32_t offset;
+
+    state = stm32_critical_enter();
+
+    offset = timer_bitmap_next(0, timer_jiffies & TIMER_SLOT_MASK);
+    if (offset >= 0)
+    {
+        next = offset + 1;
+    }
+
+    for (level = 1; level < TIMER_LEVELS; level++)
+    {
+        uint32_t shift = level * TIMER_SLOT_BITS;
+        uint32_t block = timer_jiffies >> shift;
+        uint32_t start;
+
+        offset = timer_bitmap_next(level, block & TIMER_SLOT_MASK);
+        if (offset < 0)
+        {
+            continue;
+        }
+        /* the current slot was cascaded already, unless this block has not started */
+        if (offset == 0 && (timer_jiffies & ((1UL << shift) - 1)) != 0)
+        {
+            offset = TIMER_SLOTS;
+        }
+        start = (block + offset) << shift;
+        if (start - timer_jiffies + 1 < next)
+        {
+            next = start - timer_jiffies + 1;
+        }
+    }
+
+    stm32_critical_exit(state);
+
+    return next;
+}
+
+void stm32_timer_tick(void)
+{
+    stm32_timer_t *work;
+    stm32_critical_t state;
+    uint32_t index;
+    uint32_t level;
+
+    state = stm32_critical_enter();
+
+    index = timer_jiffies & TIMER_SLOT_MASK;
+    if (index == 0)
+    {
+        for (level = 1; level < TIMER_LEVELS; level++)
+        {
+            if (timer_cascade(level, (timer_jiffies >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK) != 0)
+            {
+                break;
+            }
+        }
+    }
+    timer_jiffies++;
+
+    /* take the due slot private, callbacks may then start or stop any timer */
+    work = timer_wheel[0][index];
+    timer_wheel[0][index] = NULL;
+    timer_bitmap[0] &= ~(1ULL << index);
+    if (work != NULL)
+    {
+        work->pprev = &work;
+    }
+
+    while (work != NULL)
+    {
+        stm32_timer_t *timer = work;
+
+        timer_unlink(timer);
+        if (timer->period != 0)
+        {
+            timer->expires += timer->period;
+            timer_enqueue(timer);
+        }
+
+        stm32_critical_exit(state);
+        timer->callback(timer, timer->param);
+        state = stm32_critical_enter();
+    }
+
+    stm32_critical_exit(state);
+}
+
+void stm32_timer_advance(uint32_t ticks)
+{
+    stm32_critical_t state;
+
+    while (ticks > 0)
+    {
+        uint32_t index = timer_jiffies & TIMER_SLOT_MASK;
+        uint32_t span = TIMER_SLOTS - index;
+        int32_t offset;
+
+        if (span > ticks)
+        {
+            span = ticks;
+        }
+
+        /* no cascade due and no timer queued up to the next boundary: jump there */
+        state = stm32_critical_enter();
+        offset = timer_bitmap_next(0, index);
+        if (index != 0 && (offset < 0 || (uint32_t)offset >= span))
+        {
+            timer_jiffies += span;
+            stm32_critical_exit(state);
+            ticks -= span;
+            continue;
+        }
+        stm32_critical_exit(state);
+
+        stm32_timer_tick();
+        ticks--;
+    }
+}
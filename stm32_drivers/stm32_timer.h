@@ -0,0 +1,61 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_TIMER_H
+#define __STM32_TIMER_H
+
+#include "sdk_board.h"
+
+/*
+ * Hierarchical timer wheel ticked once per systick, see stm32_timer.c.
+ * Start, stop and expiry are O(1); timers run their callback from the
+ * context that calls stm32_timer_tick, normally SysTick_Handler.
+ */
+
+#define STM32_TIMER_MS(ms)          (((uint32_t)(ms) * SDK_SYSTICK_PER_SECOND + 999) / 1000)
+
+/* returned by stm32_timer_next_expiry when no timer is armed */
+#define STM32_TIMER_NEVER           0xFFFFFFFF
+
+typedef struct stm32_timer stm32_timer_t;
+
+struct stm32_timer
+{
+    stm32_timer_t *next;
+    stm32_timer_t **pprev;
+    uint32_t expires;           /* absolute tick */
+    uint32_t period;            /* 0 for a one shot timer */
+    void (*callback)(stm32_timer_t *timer, void *param);
+    void *param;
+    uint8_t level;              /* wheel position while armed */
+    uint8_t slot;
+};
+
+void stm32_timer_init(stm32_timer_t *timer, void (*callback)(stm32_timer_t *timer, void *param), void *param);
+void stm32_timer_start(stm32_timer_t *timer, uint32_t ticks, uint32_t period);
+void stm32_timer_stop(stm32_timer_t *timer);
+uint8_t stm32_timer_is_active(stm32_timer_t *timer);
+
+/**
+  * @brief  Ticks until the next stm32_timer_tick call that can fire a timer.
+  * @note   Exact for timers less than 64 ticks away, a lower bound otherwise
+  *         (the point where the wheel cascades them down).
+  */
+uint32_t stm32_timer_next_expiry(void);
+
+/**
+  * @brief  Advance the wheel by one tick and run the expired timers.
+  * @note   Call it from SysTick_Handler after systicks is incremented.
+  */
+void stm32_timer_tick(void);
+
+/**
+  * @brief  Advance the wheel by several ticks at once, after a tickless sleep.
+  * @note   Costs one step per 64 empty ticks; expired timers run as in tick.
+  */
+void stm32_timer_advance(uint32_t ticks);
+
+#endif
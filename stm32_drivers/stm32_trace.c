@@ -0,0 +1,138 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#include "sdk_board.h"
+#include "SEGGER_RTT.h"
+#include "stm32_trace.h"
+
+#ifdef STM32_TRACE_ENABLE
+
+#if (STM32_TRACE_BUF_SIZE & (STM32_TRACE_BUF_SIZE - 1)) != 0
+#error "STM32_TRACE_BUF_SIZE must be a power of two"
+#endif
+
+stm32_trace_event_t stm32_trace_buf[STM32_TRACE_BUF_SIZE];
+volatile uint32_t stm32_trace_head;
+volatile uint32_t stm32_trace_tail;
+volatile uint32_t stm32_trace_dropped;
+
+static char trace_rtt_buf[STM32_TRACE_RTT_SIZE];
+static uint32_t trace_dropped_sent;
+
+static uint32_t trace_put16(uint8_t *pkt, uint32_t pos, uint32_t value)
+{
+    pkt[pos++] = (uint8_t)value;
+    pkt[pos++] = (uint8_t)(value >> 8);
+    return pos;
+}
+
+static uint32_t trace_put32(uint8_t *pkt, uint32_t pos, uint32_t value)
+{
+    pos = trace_put16(pkt, pos, value);
+    return trace_put16(pkt, pos, value >> 16);
+}
+
+/* whole packets only, a partial write would desync the host */
+static uint8_t trace_send(const uint8_t *pkt, uint32_t len)
+{
+    if (SEGGER_RTT_GetAvailWriteSpace(STM32_TRACE_RTT_CHANNEL) < len)
+    {
+        return 0;
+    }
+    SEGGER_RTT_Write(STM32_TRACE_RTT_CHANNEL, pkt, len);
+    return 1;
+}
+
+static void trace_send_info(void)
+{
+    uint8_t pkt[10];
+    uint32_t len = 0;
+
+    pkt[len++] = STM32_TRACE_TYPE_INFO;
+#if STM32_USING_DWT_CYCCNT
+    pkt[len++] = STM32_TRACE_TS_CYCCNT;
+#else
+    pkt[len++] = STM32_TRACE_TS_SYSTICK;
+#endif
+    len = trace_put32(pkt, len, SystemCoreClock);
+    len = trace_put32(pkt, len, SysTick->LOAD);
+    trace_send(pkt, len);
+}
+
+/**
+  * @brief  Set up the RTT channel, the cycle counter and the driver span names.
+  */
+void stm32_trace_init(void)
+{
+    SEGGER_RTT_ConfigUpBuffer(STM32_TRACE_RTT_CHANNEL, "trace", trace_rtt_buf,
+                              sizeof(trace_rtt_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    /* enables DWT->CYCCNT where there is one */
+    stm32_get_cycles();
+
+    trace_send_info();
+    stm32_trace_name(STM32_TRACE_ID_W25QXX_BUSY, "w25qxx_busy");
+    stm32_trace_name(STM32_TRACE_ID_UART_ISR, "uart_isr");
+    stm32_trace_name(STM32_TRACE_ID_LPUART_ISR, "lpuart_isr");
+}
+
+/**
+  * @brief  Send a name for an id, the host labels its spans and counters with it.
+  */
+void stm32_trace_name(uint16_t id, const char *name)
+{
+    uint8_t pkt[4 + 32];
+    uint32_t len = strlen(name);
+
+    if (len > 32)
+    {
+        len = 32;
+    }
+    pkt[0] = STM32_TRACE_TYPE_NAME;
+    trace_put16(pkt, 1, id);
+    pkt[3] = (uint8_t)len;
+    memcpy(&pkt[4], name, len);
+    trace_send(pkt, 4 + len);
+}
+
+/**
+  * @brief  Stream the buffered events to RTT.
+  * @note   Call it from the main loop; events stay queued while RTT is full.
+  */
+void stm32_trace_flush(void)
+{
+    uint8_t pkt[11];
+    uint32_t dropped = stm32_trace_dropped;
+
+    if (dropped != trace_dropped_sent)
+    {
+        pkt[0] = STM32_TRACE_TYPE_LOST;
+        trace_put32(pkt, 1, dropped - trace_dropped_sent);
+        if (trace_send(pkt, 5))
+        {
+            trace_dropped_sent = dropped;
+        }
+    }
+
+    while (stm32_trace_tail != stm32_trace_head)
+    {
+        stm32_trace_event_t *e = &stm32_trace_buf[stm32_trace_tail & (STM32_TRACE_BUF_SIZE - 1)];
+        uint32_t type = e->info >> 16;
+        uint32_t len = 0;
+
+        pkt[len++] = (uint8_t)type;
+        len = trace_put16(pkt, len, e->info);
+        len = trace_put32(pkt, len, e->ts);
+        /* the counter value, or systicks for BEGIN and END */
+        len = trace_put32(pkt, len, e->value);
+        if (!trace_send(pkt, len))
+        {
+            break;
+        }
+        stm32_trace_tail++;
+    }
+}
+
+#endif /* STM32_TRACE_ENABLE */
@@ -0,0 +1,132 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Span and counter tracing. With STM32_TRACE_ENABLE undefined every macro
+ * expands to nothing. Otherwise an event is a timestamp plus an id written to
+ * a RAM ring under a short PRIMASK section; stm32_trace_flush, called from
+ * the main loop, streams the ring to an RTT up-buffer as packets
+ * (little endian):
+ *
+ *   BEGIN/END  type | id (u16) | ts (u32) | systicks (u32)
+ *   COUNTER    type | id (u16) | ts (u32) | value (u32)
+ *   NAME       type | id (u16) | len | name
+ *   INFO       type | ts format | core clock (u32) | SysTick reload (u32)
+ *   LOST       type | dropped events (u32)
+ *
+ * ts is DWT->CYCCNT where the core has it, otherwise (systicks << 24) | VAL,
+ * which the host turns back into cycles. Either wraps, every 256 systicks
+ * without DWT, so BEGIN and END also carry the whole systicks count: the
+ * host unwraps ts with it and spans of any length, e.g. a chip erase, are
+ * measured right. Decode and histogram the spans with tools/trace_hist.py.
+ */
+
+#ifndef __STM32_TRACE_H
+#define __STM32_TRACE_H
+
+#include "sdk_board.h"
+#include "stm32_common.h"
+
+// #define STM32_TRACE_ENABLE
+
+/* ids used by the drivers, applications number theirs from STM32_TRACE_ID_USER */
+#define STM32_TRACE_ID_W25QXX_BUSY  1
+#define STM32_TRACE_ID_UART_ISR     2
+#define STM32_TRACE_ID_LPUART_ISR   3
+#define STM32_TRACE_ID_USER         32
+
+#ifdef STM32_TRACE_ENABLE
+
+#ifndef STM32_TRACE_RTT_CHANNEL
+#define STM32_TRACE_RTT_CHANNEL     2
+#endif
+#ifndef STM32_TRACE_RTT_SIZE
+#define STM32_TRACE_RTT_SIZE        1024
+#endif
+#ifndef STM32_TRACE_BUF_SIZE
+#define STM32_TRACE_BUF_SIZE        128     /* events, power of two */
+#endif
+
+#define STM32_TRACE_TYPE_BEGIN      1
+#define STM32_TRACE_TYPE_END        2
+#define STM32_TRACE_TYPE_COUNTER    3
+#define STM32_TRACE_TYPE_NAME       4
+#define STM32_TRACE_TYPE_INFO       5
+#define STM32_TRACE_TYPE_LOST       6
+
+#define STM32_TRACE_TS_CYCCNT       0
+#define STM32_TRACE_TS_SYSTICK      1
+
+typedef struct
+{
+    uint32_t ts;
+    uint32_t info;      /* type << 16 | id */
+    uint32_t value;
+} stm32_trace_event_t;
+
+extern stm32_trace_event_t stm32_trace_buf[STM32_TRACE_BUF_SIZE];
+extern volatile uint32_t stm32_trace_head;
+extern volatile uint32_t stm32_trace_tail;
+extern volatile uint32_t stm32_trace_dropped;
+extern volatile uint32_t systicks;
+
+void stm32_trace_init(void);
+void stm32_trace_name(uint16_t id, const char *name);
+void stm32_trace_flush(void);
+
+static inline void stm32_trace_event(uint32_t info, uint32_t value)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t head;
+    uint32_t ticks;
+    stm32_trace_event_t *e;
+
+    __disable_irq();
+    head = stm32_trace_head;
+    if (head - stm32_trace_tail >= STM32_TRACE_BUF_SIZE)
+    {
+        stm32_trace_dropped++;
+        __set_PRIMASK(primask);
+        return;
+    }
+    e = &stm32_trace_buf[head & (STM32_TRACE_BUF_SIZE - 1)];
+#if STM32_USING_DWT_CYCCNT
+    e->ts = DWT->CYCCNT;
+    ticks = systicks;
+#else
+    {
+        uint32_t val = SysTick->VAL;
+
+        ticks = systicks;
+        if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+        {
+            val = SysTick->VAL;
+            ticks++;
+        }
+        e->ts = (ticks << 24) | val;
+    }
+#endif
+    e->info = info;
+    e->value = (info >> 16) == STM32_TRACE_TYPE_COUNTER ? value : ticks;
+    stm32_trace_head = head + 1;
+    __set_PRIMASK(primask);
+}
+
+#define STM32_TRACE_BEGIN(id)           stm32_trace_event((STM32_TRACE_TYPE_BEGIN << 16) | (id), 0)
+#define STM32_TRACE_END(id)             stm32_trace_event((STM32_TRACE_TYPE_END << 16) | (id), 0)
+#define STM32_TRACE_COUNTER(id, value)  stm32_trace_event((STM32_TRACE_TYPE_COUNTER << 16) | (id), (value))
+#define STM32_TRACE_NAME(id, name)      stm32_trace_name((id), (name))
+
+#else
+
+#define STM32_TRACE_BEGIN(id)           do {} while (0)
+#define STM32_TRACE_END(id)             do {} while (0)
+#define STM32_TRACE_COUNTER(id, value)  do {} while (0)
+#define STM32_TRACE_NAME(id, name)      do {} while (0)
+
+#endif /* STM32_TRACE_ENABLE */
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32_UART_H
+#define __STM32_UART_H
+
+#include "sdk_board.h"
+#include "sdk_uart.h"
+#include "stm32_common.h"
+
+/* BSP specific uart control commands, kept clear of the SDK_CONTROL_UART_* range */
+#define STM32_CONTROL_UART_BASE             0x80
+#define STM32_CONTROL_UART_GET_STATS        (STM32_CONTROL_UART_BASE + 0)  /* args: stm32_uart_stats_t * */
+#define STM32_CONTROL_UART_RESET_STATS      (STM32_CONTROL_UART_BASE + 1)  /* args: unused */
+#define STM32_CONTROL_UART_SET_CONFIG       (STM32_CONTROL_UART_BASE + 2)  /* args: stm32_uart_config_t *, applied by the next open */
+#define STM32_CONTROL_UART_RX_RESUME        (STM32_CONTROL_UART_BASE + 3)  /* args: unused, call after draining the rx fifo */
+#define STM32_CONTROL_UART_SET_WAKEUP       (STM32_CONTROL_UART_BASE + 4)  /* args: stm32_uart_wakeup_t *, lpuart only */
+#define STM32_CONTROL_UART_SET_CHAR_MATCH   (STM32_CONTROL_UART_BASE + 5)  /* args: stm32_uart_char_match_t *, shares ADD with address wakeup */
+#define STM32_CONTROL_UART_GET_BAUDRATE     (STM32_CONTROL_UART_BASE + 6)  /* args: uint32_t *, fails until auto-baud has completed */
+#define STM32_CONTROL_UART_AUTOBAUD_SCAN    (STM32_CONTROL_UART_BASE + 7)  /* args: uint32_t *, software scan when ABR is missing or failed */
+
+/*
+ * NVIC priority the uart and lpuart ports start with (irq_prio). It must stay
+ * numerically below STM32_CRITICAL_LEVEL_DRIVER, which flash and EEPROM
+ * writes mask up to, for RX to keep running through them; a port given an
+ * irq_prio at or above that level loses RX for the length of a write.
+ */
+#ifndef STM32_UART_IRQ_PRIO
+#define STM32_UART_IRQ_PRIO                 1
+#endif
+
+#if STM32_UART_IRQ_PRIO >= STM32_CRITICAL_LEVEL_DRIVER
+#error "STM32_UART_IRQ_PRIO must be below STM32_CRITICAL_LEVEL_DRIVER, or RX stops during flash writes"
+#endif
+
+/* pass as baudrate to open to start hardware auto-baud detection (USART1/USART2) */
+#define STM32_UART_BAUDRATE_AUTO            0
+
+#define STM32_UART_FLOWCTRL_NONE            0
+#define STM32_UART_FLOWCTRL_RTS             1
+#define STM32_UART_FLOWCTRL_CTS             2
+#define STM32_UART_FLOWCTRL_RTS_CTS         3
+
+#define STM32_UART_OVERSAMPLING_16          0
+#define STM32_UART_OVERSAMPLING_8           1
+
+#define STM32_UART_AUTOBAUD_STARTBIT        0   /* any character starting with 10xx */
+#define STM32_UART_AUTOBAUD_FALLINGEDGE     1   /* any character starting with 10xx and a falling edge after 1 bit */
+#define STM32_UART_AUTOBAUD_0X7F            2   /* 0x7F frame */
+#define STM32_UART_AUTOBAUD_0X55            3   /* 0x55 frame */
+
+typedef struct
+{
+    uint8_t flow_control;       /* STM32_UART_FLOWCTRL_xxx */
+    uint8_t oversampling;       /* STM32_UART_OVERSAMPLING_xxx, 8x doubles the reachable baudrate */
+    uint16_t rx_throttle_high;  /* rx fifo fill that stops reading RDR so RTS deasserts, 0 disables */
+    uint16_t rx_throttle_low;   /* rx fifo fill at which STM32_CONTROL_UART_RX_RESUME restarts rx */
+    uint8_t autobaud_mode;      /* STM32_UART_AUTOBAUD_xxx, used with STM32_UART_BAUDRATE_AUTO */
+} stm32_uart_config_t;
+
+#define STM32_UART_WAKEUP_NONE              0
+#define STM32_UART_WAKEUP_STARTBIT          1
+#define STM32_UART_WAKEUP_RXNE              2
+#define STM32_UART_WAKEUP_ADDRESS           3
+
+typedef struct
+{
+    uint8_t mode;               /* STM32_UART_WAKEUP_xxx */
+    uint8_t address;            /* node address for STM32_UART_WAKEUP_ADDRESS */
+    uint8_t address_len;        /* 4 or 7 bit address */
+} stm32_uart_wakeup_t;
+
+typedef struct
+{
+    uint8_t enable;
+    uint8_t ch;                 /* delimiter, e.g. '\n' */
+    void (*callback)(void);     /* called from the isr once ch is in the rx fifo */
+} stm32_uart_char_match_t;
+
+typedef struct
+{
+    uint32_t rx_bytes;          /* bytes read out of RDR */
+    uint32_t tx_bytes;          /* bytes written to TDR */
+    uint32_t rx_frames;         /* idle line detected after reception */
+    uint32_t overrun_errors;    /* ORE */
+    uint32_t framing_errors;    /* FE */
+    uint32_t noise_errors;      /* NE */
+    uint32_t rx_fifo_hwm;       /* highest rx fifo fill level seen in the isr */
+    uint32_t isr_max_cycles;    /* longest irq handler run, in core cycles */
+} stm32_uart_stats_t;
+
+/**
+  * @brief  Current rx fifo fill level of a port, used for the high watermark.
+  * @note   Weak, returns 0. Override it where the rx fifo of sdk_uart is visible.
+  */
+int32_t stm32_uart_rx_fifo_len(sdk_uart_t *uart);
+
+#endif
@@ -6,12 +6,57 @@
 
 #include "sdk_board.h"
 #include "sdk_uart.h"
+#include "stm32_uart.h"
+#include "stm32_common.h"
+#include "stm32_trace.h"
 
 extern sdk_uart_t uart1;
 extern sdk_uart_t uart2;
 extern sdk_uart_t uart4;
 extern sdk_uart_t uart5;
 
+/* provisional rate programmed while hardware auto-baud waits for the first frame */
+#define UART_AUTOBAUD_INIT_RATE     115200
+/* time spent listening at each rate of the software scan */
+#define UART_SCAN_WINDOW_MS         50
+/* error free frames needed to accept a rate */
+#define UART_SCAN_GOOD_FRAMES       3
+
+static const uint32_t uart_scan_rates[] =
+{
+    115200, 9600, 57600, 38400, 19200, 230400, 460800, 921600, 4800, 2400,
+};
+
+struct stm32_uart_priv
+{
+    stm32_uart_config_t config;
+    stm32_uart_stats_t stats;
+    volatile uint8_t rx_throttled;
+    void (*match_callback)(void);
+};
+
+static struct stm32_uart_priv uart1_priv;
+static struct stm32_uart_priv uart2_priv;
+static struct stm32_uart_priv uart4_priv;
+static struct stm32_uart_priv uart5_priv;
+
+static struct stm32_uart_priv *stm32_uart_priv_get(sdk_uart_t *uart)
+{
+    if(uart->instance == USART1)
+    {
+        return &uart1_priv;
+    }
+    else if(uart->instance == USART2)
+    {
+        return &uart2_priv;
+    }
+    else if(uart->instance == USART4)
+    {
+        return &uart4_priv;
+    }
+    return &uart5_priv;
+}
+
 __WEAK int stm32_uart_msp_init(sdk_uart_t *uart)
 {
     return -SDK_ERROR;
@@ -22,9 +67,15 @@ __WEAK int stm32_uart_msp_deinit(sdk_uart_t *uart)
     return -SDK_ERROR;
 }
 
+__WEAK int32_t stm32_uart_rx_fifo_len(sdk_uart_t *uart)
+{
+    return 0;
+}
+
 static int32_t stm32_uart_open(sdk_uart_t *uart, int32_t baudrate, int32_t data_bit, char parity, int32_t stop_bit)
 {
     LL_USART_InitTypeDef USART_InitStruct = {0};
+    struct stm32_uart_priv *priv = stm32_uart_priv_get(uart);
 
     // msp init
     if (stm32_uart_msp_init(uart) != SDK_OK)
@@ -57,7 +108,7 @@ static int32_t stm32_uart_open(sdk_uart_t *uart, int32_t baudrate, int32_t data_
         return -SDK_ERROR;
     }
 
-    USART_InitStruct.BaudRate = baudrate;
+    USART_InitStruct.BaudRate = (baudrate == STM32_UART_BAUDRATE_AUTO) ? UART_AUTOBAUD_INIT_RATE : baudrate;
 
     switch (data_bit)
     {
@@ -98,11 +149,61 @@ static int32_t stm32_uart_open(sdk_uart_t *uart, int32_t baudrate, int32_t data_
         break;
     }
 
+    switch (priv->config.flow_control)
+    {
+    case STM32_UART_FLOWCTRL_RTS:
+        USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_RTS;
+        break;
+    case STM32_UART_FLOWCTRL_CTS:
+        USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_CTS;
+        break;
+    case STM32_UART_FLOWCTRL_RTS_CTS:
+        USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_RTS_CTS;
+        break;
+    case STM32_UART_FLOWCTRL_NONE:
+    default:
+        USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_NONE;
+        break;
+    }
+
+    switch (priv->config.oversampling)
+    {
+    case STM32_UART_OVERSAMPLING_8:
+        USART_InitStruct.OverSampling = LL_USART_OVERSAMPLING_8;
+        break;
+    case STM32_UART_OVERSAMPLING_16:
+    default:
+        USART_InitStruct.OverSampling = LL_USART_OVERSAMPLING_16;
+        break;
+    }
+
     USART_InitStruct.TransferDirection = LL_USART_DIRECTION_TX_RX;
-    USART_InitStruct.HardwareFlowControl = LL_USART_HWCONTROL_NONE;
+    priv->rx_throttled = 0;
     LL_USART_Init(uart->instance, &USART_InitStruct);
     LL_USART_ConfigAsyncMode(uart->instance);
 
+    /* ABR is only implemented on USART1/USART2, the others use the software scan */
+    if (baudrate == STM32_UART_BAUDRATE_AUTO && IS_USART_AUTOBAUDRATE_DETECTION_INSTANCE(uart->instance))
+    {
+        switch (priv->config.autobaud_mode)
+        {
+        case STM32_UART_AUTOBAUD_FALLINGEDGE:
+            LL_USART_SetAutoBaudRateMode(uart->instance, LL_USART_AUTOBAUD_DETECT_ON_FALLINGEDGE);
+            break;
+        case STM32_UART_AUTOBAUD_0X7F:
+            LL_USART_SetAutoBaudRateMode(uart->instance, LL_USART_AUTOBAUD_DETECT_ON_7F_FRAME);
+            break;
+        case STM32_UART_AUTOBAUD_0X55:
+            LL_USART_SetAutoBaudRateMode(uart->instance, LL_USART_AUTOBAUD_DETECT_ON_55_FRAME);
+            break;
+        case STM32_UART_AUTOBAUD_STARTBIT:
+        default:
+            LL_USART_SetAutoBaudRateMode(uart->instance, LL_USART_AUTOBAUD_DETECT_ON_STARTBIT);
+            break;
+        }
+        LL_USART_EnableAutoBaudRate(uart->instance);
+    }
+
     LL_USART_Enable(uart->instance);
 
     while((!(LL_USART_IsActiveFlag_TEACK(uart->instance))) || (!(LL_USART_IsActiveFlag_REACK(uart->instance))))
@@ -129,6 +230,7 @@ static int32_t stm32_uart_putc(sdk_uart_t *uart, int32_t ch)
 {
     while(0 == LL_USART_IsActiveFlag_TXE(uart->instance));
     LL_USART_TransmitData8(uart->instance, (uint8_t) ch);
+    stm32_uart_priv_get(uart)->stats.tx_bytes++;
     return ch;
 }
 
@@ -137,12 +239,160 @@ static int32_t stm32_uart_getc(sdk_uart_t *uart)
     int ch = -1;
 
     if (LL_USART_IsActiveFlag_RXNE(uart->instance) != 0)
+    {
         ch = LL_USART_ReceiveData8(uart->instance);
+        stm32_uart_priv_get(uart)->stats.rx_bytes++;
+    }
     return ch;
 }
 
+static uint32_t stm32_uart_get_clock(sdk_uart_t *uart)
+{
+    LL_RCC_ClocksTypeDef clocks;
+
+    if(uart->instance == USART1)
+    {
+        return LL_RCC_GetUSARTClockFreq(LL_RCC_USART1_CLKSOURCE);
+    }
+    else if(uart->instance == USART2)
+    {
+        return LL_RCC_GetUSARTClockFreq(LL_RCC_USART2_CLKSOURCE);
+    }
+
+    /* USART4/USART5 are always clocked from PCLK1 */
+    LL_RCC_GetSystemClocksFreq(&clocks);
+    return clocks.PCLK1_Frequency;
+}
+
+static uint32_t stm32_uart_get_baudrate(sdk_uart_t *uart)
+{
+    return LL_USART_GetBaudRate(uart->instance, stm32_uart_get_clock(uart),
+                                LL_USART_GetOverSampling(uart->instance));
+}
+
+static void stm32_uart_set_baudrate(sdk_uart_t *uart, uint32_t baudrate)
+{
+    /* BRR and ABREN can only be written while UE is cleared */
+    LL_USART_Disable(uart->instance);
+    LL_USART_DisableAutoBaudRate(uart->instance);
+    LL_USART_SetBaudRate(uart->instance, stm32_uart_get_clock(uart),
+                         LL_USART_GetOverSampling(uart->instance), baudrate);
+    LL_USART_Enable(uart->instance);
+    while((!(LL_USART_IsActiveFlag_TEACK(uart->instance))) || (!(LL_USART_IsActiveFlag_REACK(uart->instance))))
+    {
+    }
+}
+
+/**
+  * @brief  Listen on each common rate for a short window and keep the first
+  *         one that receives error free frames.
+  * @note   Bounded to UART_SCAN_WINDOW_MS per rate. The rx interrupt is held
+  *         off during the scan, the previous rate is restored on failure.
+  */
+static int32_t stm32_uart_autobaud_scan(sdk_uart_t *uart, uint32_t *baudrate)
+{
+    struct stm32_uart_priv *priv = stm32_uart_priv_get(uart);
+    uint32_t old_rate = stm32_uart_get_baudrate(uart);
+    uint32_t rx_it = LL_USART_IsEnabledIT_RXNE(uart->instance);
+    uint32_t window = UART_SCAN_WINDOW_MS * SDK_SYSTICK_PER_SECOND / 1000;
+    int32_t pattern = -1;
+    uint32_t i;
+
+    if (priv->config.autobaud_mode == STM32_UART_AUTOBAUD_0X7F)
+    {
+        pattern = 0x7F;
+    }
+    else if (priv->config.autobaud_mode == STM32_UART_AUTOBAUD_0X55)
+    {
+        pattern = 0x55;
+    }
+
+    LL_USART_DisableIT_RXNE(uart->instance);
+
+    for (i = 0; i < sizeof(uart_scan_rates) / sizeof(uart_scan_rates[0]); i++)
+    {
+        uint32_t begin;
+        uint32_t good = 0;
+
+        stm32_uart_set_baudrate(uart, uart_scan_rates[i]);
+        LL_USART_RequestRxDataFlush(uart->instance);
+        LL_USART_ClearFlag_ORE(uart->instance);
+        LL_USART_ClearFlag_FE(uart->instance);
+        LL_USART_ClearFlag_NE(uart->instance);
+        LL_USART_ClearFlag_PE(uart->instance);
+
+        begin = sdk_hw_get_systick();
+        while (sdk_hw_get_systick() - begin < window && good < UART_SCAN_GOOD_FRAMES)
+        {
+            if (LL_USART_IsActiveFlag_FE(uart->instance) || LL_USART_IsActiveFlag_NE(uart->instance) ||
+                LL_USART_IsActiveFlag_PE(uart->instance))
+            {
+                break;
+            }
+            if (LL_USART_IsActiveFlag_RXNE(uart->instance))
+            {
+                uint8_t ch = LL_USART_ReceiveData8(uart->instance);
+                if (pattern >= 0 && ch != pattern)
+                {
+                    break;
+                }
+                good++;
+            }
+        }
+
+        if (good >= UART_SCAN_GOOD_FRAMES)
+        {
+            *baudrate = uart_scan_rates[i];
+            if (rx_it)
+            {
+                LL_USART_EnableIT_RXNE(uart->instance);
+            }
+            return SDK_OK;
+        }
+    }
+
+    stm32_uart_set_baudrate(uart, old_rate);
+    if (rx_it)
+    {
+        LL_USART_EnableIT_RXNE(uart->instance);
+    }
+    return -SDK_E_TIMEOUT;
+}
+
+static int32_t stm32_uart_set_char_match(sdk_uart_t *uart, stm32_uart_char_match_t *match)
+{
+    struct stm32_uart_priv *priv = stm32_uart_priv_get(uart);
+
+    if (match == NULL)
+    {
+        return -SDK_E_INVALID;
+    }
+
+    LL_USART_DisableIT_CM(uart->instance);
+    priv->match_callback = match->callback;
+    if (match->enable == 0)
+    {
+        return SDK_OK;
+    }
+
+    /* ADD can only be written while UE is cleared, outside mute mode all 8 bits are compared */
+    LL_USART_Disable(uart->instance);
+    LL_USART_ConfigNodeAddress(uart->instance, LL_USART_ADDRESS_DETECT_7B, match->ch);
+    LL_USART_Enable(uart->instance);
+    while((!(LL_USART_IsActiveFlag_TEACK(uart->instance))) || (!(LL_USART_IsActiveFlag_REACK(uart->instance))))
+    {
+    }
+
+    LL_USART_ClearFlag_CM(uart->instance);
+    LL_USART_EnableIT_CM(uart->instance);
+
+    return SDK_OK;
+}
+
 static int32_t stm32_uart_control(sdk_uart_t *uart, int32_t cmd, void *args)
 {
+    struct stm32_uart_priv *priv = stm32_uart_priv_get(uart);
+
     switch (cmd)
     {
     case SDK_CONTROL_UART_DISABLE_INT:
@@ -151,6 +401,7 @@ static int32_t stm32_uart_control(sdk_uart_t *uart, int32_t cmd, void *args)
         NVIC_DisableIRQ(uart->irq);
         break;
     case SDK_CONTROL_UART_ENABLE_INT:
+        priv->rx_throttled = 0;
         NVIC_SetPriority(uart->irq, uart->irq_prio);
         NVIC_EnableIRQ(uart->irq);
         LL_USART_EnableIT_RXNE(uart->instance);
@@ -173,122 +424,149 @@ static int32_t stm32_uart_control(sdk_uart_t *uart, int32_t cmd, void *args)
     case SDK_CONTROL_UART_DISABLE_RX:
         LL_USART_DisableDirectionRx(uart->instance);
         break;
+    case STM32_CONTROL_UART_GET_STATS:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        sdk_hw_interrupt_disable();
+        memcpy(args, &priv->stats, sizeof(stm32_uart_stats_t));
+        sdk_hw_interrupt_enable();
+        break;
+    case STM32_CONTROL_UART_RESET_STATS:
+        sdk_hw_interrupt_disable();
+        memset(&priv->stats, 0, sizeof(stm32_uart_stats_t));
+        sdk_hw_interrupt_enable();
+        break;
+    case STM32_CONTROL_UART_SET_CONFIG:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        memcpy(&priv->config, args, sizeof(stm32_uart_config_t));
+        break;
+    case STM32_CONTROL_UART_SET_CHAR_MATCH:
+        return stm32_uart_set_char_match(uart, (stm32_uart_char_match_t *)args);
+    case STM32_CONTROL_UART_GET_BAUDRATE:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        if (LL_USART_IsEnabledAutoBaud(uart->instance) &&
+            (LL_USART_IsActiveFlag_ABRE(uart->instance) || !LL_USART_IsActiveFlag_ABR(uart->instance)))
+        {
+            return -SDK_ERROR;
+        }
+        *(uint32_t *)args = stm32_uart_get_baudrate(uart);
+        break;
+    case STM32_CONTROL_UART_AUTOBAUD_SCAN:
+        if (args == NULL)
+        {
+            return -SDK_E_INVALID;
+        }
+        return stm32_uart_autobaud_scan(uart, (uint32_t *)args);
+    case STM32_CONTROL_UART_RX_RESUME:
+        /* RDR is read again, the hardware reasserts RTS on its own */
+        if (priv->rx_throttled && stm32_uart_rx_fifo_len(uart) <= priv->config.rx_throttle_low)
+        {
+            priv->rx_throttled = 0;
+            LL_USART_EnableIT_RXNE(uart->instance);
+        }
+        break;
     }
 
     return SDK_OK;
 }
 
-void USART1_IRQHandler(void)
+static void stm32_uart_irq_handler(sdk_uart_t *uart)
 {
-    if(LL_USART_IsActiveFlag_RXNE(uart1.instance) && LL_USART_IsEnabledIT_RXNE(uart1.instance))
-    {
-        sdk_uart_rx_isr(&uart1);
-    }
+    struct stm32_uart_priv *priv = stm32_uart_priv_get(uart);
+    uint32_t start = SysTick->VAL;
+    uint32_t cycles;
 
-    if(LL_USART_IsActiveFlag_IDLE(uart1.instance) && LL_USART_IsEnabledIT_IDLE(uart1.instance))
+    STM32_TRACE_BEGIN(STM32_TRACE_ID_UART_ISR);
+    if(LL_USART_IsActiveFlag_RXNE(uart->instance) && LL_USART_IsEnabledIT_RXNE(uart->instance))
     {
-        LL_USART_ClearFlag_IDLE(uart1.instance);
-        if(uart1.rx_idle_callback != NULL)
+        int32_t len;
+
+        sdk_uart_rx_isr(uart);
+        len = stm32_uart_rx_fifo_len(uart);
+        if(len > 0 && (uint32_t)len > priv->stats.rx_fifo_hwm)
         {
-            uart1.rx_idle_callback();
+            priv->stats.rx_fifo_hwm = len;
         }
-    }
-    if(LL_USART_IsActiveFlag_ORE(uart1.instance))
-    {
-        LL_USART_ClearFlag_ORE(uart1.instance);
-    }
-    if(LL_USART_IsActiveFlag_FE(uart1.instance))
-    {
-        LL_USART_ClearFlag_FE(uart1.instance);
-    }
-        if(LL_USART_IsActiveFlag_NE(uart1.instance))
-    {
-        LL_USART_ClearFlag_NE(uart1.instance);
-    }
-}
-
-void USART2_IRQHandler(void)
-{
-    if(LL_USART_IsActiveFlag_RXNE(USART2) && LL_USART_IsEnabledIT_RXNE(USART2))
-    {
-        sdk_uart_rx_isr(&uart2);
-    }
-
-    if(LL_USART_IsActiveFlag_IDLE(USART2) && LL_USART_IsEnabledIT_IDLE(USART2))
-    {
-        LL_USART_ClearFlag_IDLE(USART2);
-        if(uart2.rx_idle_callback != NULL)
+        /* leave the next byte in RDR, hardware RTS then holds off the sender */
+        if(priv->config.rx_throttle_high != 0 && len >= priv->config.rx_throttle_high
+           && (priv->config.flow_control & STM32_UART_FLOWCTRL_RTS))
         {
-            uart2.rx_idle_callback();
+            LL_USART_DisableIT_RXNE(uart->instance);
+            priv->rx_throttled = 1;
         }
     }
-    if(LL_USART_IsActiveFlag_ORE(USART2))
-    {
-        LL_USART_ClearFlag_ORE(USART2);
-    }
-    if(LL_USART_IsActiveFlag_FE(USART2))
-    {
-        LL_USART_ClearFlag_FE(USART2);
-    }
-        if(LL_USART_IsActiveFlag_NE(USART2))
-    {
-        LL_USART_ClearFlag_NE(USART2);
-    }
-}
 
-void USART4_5_IRQHandler(void)
-{
-    if(LL_USART_IsActiveFlag_RXNE(USART5) && LL_USART_IsEnabledIT_RXNE(USART5))
+    /* after RXNE, so the delimiter is already in the rx fifo */
+    if(LL_USART_IsActiveFlag_CM(uart->instance) && LL_USART_IsEnabledIT_CM(uart->instance))
     {
-        sdk_uart_rx_isr(&uart5);
-    }
-    else if(LL_USART_IsActiveFlag_RXNE(USART4) && LL_USART_IsEnabledIT_RXNE(USART4))
-    {
-        sdk_uart_rx_isr(&uart4);
-    }
-
-    if(LL_USART_IsActiveFlag_IDLE(USART5) && LL_USART_IsEnabledIT_IDLE(USART5))
-    {
-        LL_USART_ClearFlag_IDLE(USART5);
-        if(uart5.rx_idle_callback != NULL)
+        LL_USART_ClearFlag_CM(uart->instance);
+        if(priv->match_callback != NULL)
         {
-            uart5.rx_idle_callback();
+            priv->match_callback();
         }
     }
-    else if(LL_USART_IsActiveFlag_IDLE(USART4) && LL_USART_IsEnabledIT_IDLE(USART4))
+
+    if(LL_USART_IsActiveFlag_IDLE(uart->instance) && LL_USART_IsEnabledIT_IDLE(uart->instance))
     {
-        LL_USART_ClearFlag_IDLE(USART4);
-        if(uart4.rx_idle_callback != NULL)
+        LL_USART_ClearFlag_IDLE(uart->instance);
+        priv->stats.rx_frames++;
+        if(uart->rx_idle_callback != NULL)
         {
-            uart4.rx_idle_callback();
+            uart->rx_idle_callback();
         }
     }
-
-    if(LL_USART_IsActiveFlag_ORE(USART5))
+    if(LL_USART_IsActiveFlag_ORE(uart->instance))
     {
-        LL_USART_ClearFlag_ORE(USART5);
+        LL_USART_ClearFlag_ORE(uart->instance);
+        priv->stats.overrun_errors++;
     }
-    else if(LL_USART_IsActiveFlag_ORE(USART4))
+    if(LL_USART_IsActiveFlag_FE(uart->instance))
     {
-        LL_USART_ClearFlag_ORE(USART4);
+        LL_USART_ClearFlag_FE(uart->instance);
+        priv->stats.framing_errors++;
     }
-
-    if(LL_USART_IsActiveFlag_FE(USART5))
+    if(LL_USART_IsActiveFlag_NE(uart->instance))
     {
-        LL_USART_ClearFlag_FE(USART5);
+        LL_USART_ClearFlag_NE(uart->instance);
+        priv->stats.noise_errors++;
     }
-    else if(LL_USART_IsActiveFlag_FE(USART4))
+
+    cycles = stm32_systick_elapsed(start);
+    if(cycles > priv->stats.isr_max_cycles)
     {
-        LL_USART_ClearFlag_FE(USART4);
+        priv->stats.isr_max_cycles = cycles;
     }
+    STM32_TRACE_END(STM32_TRACE_ID_UART_ISR);
+}
 
-    if(LL_USART_IsActiveFlag_NE(USART5))
+void USART1_IRQHandler(void)
+{
+    stm32_uart_irq_handler(&uart1);
+}
+
+void USART2_IRQHandler(void)
+{
+    stm32_uart_irq_handler(&uart2);
+}
+
+void USART4_5_IRQHandler(void)
+{
+    /* shared vector, only service the ports that are opened */
+    if(LL_USART_IsEnabled(USART5))
     {
-        LL_USART_ClearFlag_NE(USART5);
+        stm32_uart_irq_handler(&uart5);
     }
-    else if(LL_USART_IsActiveFlag_NE(USART4))
+    if(LL_USART_IsEnabled(USART4))
     {
-        LL_USART_ClearFlag_NE(USART4);
+        stm32_uart_irq_handler(&uart4);
     }
 }
 
@@ -296,7 +574,7 @@ sdk_uart_t uart1 =
 {
     .instance = USART1,
     .irq = USART1_IRQn,
-    .irq_prio = 1,
+    .irq_prio = STM32_UART_IRQ_PRIO,
     .ops.open = stm32_uart_open,
     .ops.close = stm32_uart_close,
     .ops.putc = stm32_uart_putc,
@@ -311,7 +589,7 @@ sdk_uart_t uart2 =
 {
     .instance = USART2,
     .irq = USART2_IRQn,
-    .irq_prio = 1,
+    .irq_prio = STM32_UART_IRQ_PRIO,
     .ops.open = stm32_uart_open,
     .ops.close = stm32_uart_close,
     .ops.putc = stm32_uart_putc,
@@ -326,7 +604,7 @@ sdk_uart_t uart4 =
 {
     .instance = USART4,
     .irq = USART4_5_IRQn,
-    .irq_prio = 1,
+    .irq_prio = STM32_UART_IRQ_PRIO,
     .ops.open = stm32_uart_open,
     .ops.close = stm32_uart_close,
     .ops.putc = stm32_uart_putc,
@@ -341,7 +619,7 @@ sdk_uart_t uart5 =
 {
     .instance = USART5,
     .irq = USART4_5_IRQn,
-    .irq_prio = 1,
+    .irq_prio = STM32_UART_IRQ_PRIO,
     .ops.open = stm32_uart_open,
     .ops.close = stm32_uart_close,
     .ops.putc = stm32_uart_putc,
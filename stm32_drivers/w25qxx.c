@@ -26,6 +26,9 @@
 #define DBG_TAG "w25q"
 #define DBG_LVL DBG_NONE
 #include "sdk_log.h"
+#include "stm32_log.h"
+#include "stm32_trace.h"
+#include "stm32_dma.h"
 
 #define W25_DBG LOG_D
 
@@ -34,6 +37,8 @@ uint8_t aRxBuffer[SPI_RX_BUFFER_SIZE] = {0};
 __IO uint8_t ubReceiveIndex = 0;
 #define SPI_TIMEOUT 1000
 #define HAL_MAX_DELAY      0xFFFFFFFF
+#define W25QXX_BUSY_TIMEOUT HAL_MAX_DELAY
+#define W25QXX_DMA_MAX 0xFFFF
 
 static inline void cs_on(W25QXX_HandleTypeDef *w25qxx)
 {
@@ -158,9 +163,11 @@ static W25QXX_result_t w25qxx_wait_for_ready(W25QXX_HandleTypeDef *w25qxx, uint3
     W25QXX_result_t ret = W25QXX_Ok;
     uint32_t begin = sdk_hw_get_systick();
     uint32_t now = sdk_hw_get_systick();
+    STM32_TRACE_BEGIN(STM32_TRACE_ID_W25QXX_BUSY);
     while ((now - begin <= timeout) && (w25qxx_get_status(w25qxx) && 0x01 == 0x01)) {
         now = sdk_hw_get_systick();
     }
+    STM32_TRACE_END(STM32_TRACE_ID_W25QXX_BUSY);
     if (now - begin == timeout)
         ret = W25QXX_Timeout;
     return ret;
@@ -184,6 +191,7 @@ W25QXX_result_t w25qxx_init(W25QXX_HandleTypeDef *w25qxx)
     // w25qxx->spiHandle = hspi;
     // w25qxx->cs_port = cs_port;
     // w25qxx->cs_pin = cs_pin;
+    w25qxx->owner = NULL;
 
     cs_off(w25qxx);
 
@@ -252,10 +260,19 @@ W25QXX_result_t w25qxx_init(W25QXX_HandleTypeDef *w25qxx)
 }
 #endif
 
+/* blocking calls first finish an operation holding the device, stepping it alone */
+static void w25qxx_wait_idle(W25QXX_HandleTypeDef *w25qxx) {
+    while (w25qxx->owner != NULL) {
+        stm32_async_step(&w25qxx->owner->async);
+    }
+}
+
 W25QXX_result_t w25qxx_read(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len) {
 
     W25_DBG("w25qxx_read - address: 0x%08lx, lengh: 0x%04lx", address, len);
 
+    w25qxx_wait_idle(w25qxx);
+
     // Transmit buffer holding command and address
     uint8_t tx[4] = {
     W25QXX_READ_DATA, (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) (address), };
@@ -277,108 +294,292 @@ W25QXX_result_t w25qxx_read(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint
     return W25QXX_Ok;
 }
 
-W25QXX_result_t w25qxx_write(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len) {
-
-    W25_DBG("w25qxx_write - address 0x%08lx len 0x%04lx", address, len);
+/* 1 once the device is idle or the wait has timed out, then op->timeout tells which */
+static uint8_t w25qxx_async_ready(W25QXX_async_t *op) {
+    if ((w25qxx_get_status(op->w25qxx) & 0x01) == 0) {
+        STM32_TRACE_END(STM32_TRACE_ID_W25QXX_BUSY);
+        return 1;
+    }
+    if (sdk_hw_get_systick() - op->begin > W25QXX_BUSY_TIMEOUT) {
+        STM32_TRACE_END(STM32_TRACE_ID_W25QXX_BUSY);
+        op->timeout = 1;
+        return 1;
+    }
+    return 0;
+}
 
-    // Let's determine the pages
-    uint32_t first_page = address / w25qxx->page_size;
-    uint32_t last_page = (address + len - 1) / w25qxx->page_size;
+#define W25QXX_ASYNC_WAIT_READY(op)                                     \
+    do {                                                                \
+        (op)->begin = sdk_hw_get_systick();                             \
+        STM32_TRACE_BEGIN(STM32_TRACE_ID_W25QXX_BUSY);                  \
+        STM32_ASYNC_WAIT_UNTIL(&(op)->async, w25qxx_async_ready(op));   \
+        if ((op)->timeout) {                                            \
+            STM32_ASYNC_EXIT(&(op)->async, -SDK_E_TIMEOUT);             \
+        }                                                               \
+    } while (0)
+
+/* write enable plus a command with a 24 bit address, then data when len is not 0 */
+static W25QXX_result_t w25qxx_command(W25QXX_HandleTypeDef *w25qxx, uint8_t cmd, uint32_t address, uint8_t *buf, uint32_t len) {
+    W25QXX_result_t ret = W25QXX_Err;
+    uint8_t tx[4] = {
+    cmd, (uint8_t) (address >> 16), (uint8_t) (address >> 8), (uint8_t) (address), };
 
-    W25_DBG("w25qxx_write %lu pages from %lu to %lu", 1 + last_page - first_page, first_page, last_page);
+    if (w25qxx_write_enable(w25qxx) != W25QXX_Ok) {
+        return W25QXX_Err;
+    }
+    cs_on(w25qxx);
+    if (w25qxx_transmit(w25qxx, tx, cmd == W25QXX_CHIP_ERASE ? 1 : 4) == W25QXX_Ok) {
+        if (len == 0 || w25qxx_transmit(w25qxx, buf, len) == W25QXX_Ok) {
+            ret = W25QXX_Ok;
+        }
+    }
+    cs_off(w25qxx);
+    return ret;
+}
 
-    uint32_t buffer_offset = 0;
-    uint32_t start_address = address;
+static int32_t w25qxx_write_poll(stm32_async_t *async) {
+    W25QXX_async_t *op = (W25QXX_async_t *) async;
+    uint32_t write_len;
 
-    for (uint32_t page = first_page; page <= last_page; ++page) {
+    STM32_ASYNC_BEGIN(async);
+    while (op->address < op->end) {
+        W25QXX_ASYNC_WAIT_READY(op);
 
-        uint32_t write_len = w25qxx->page_size - (start_address & (w25qxx->page_size - 1));
-        write_len = len > write_len ? write_len : len;
+        // up to the end of the page
+        write_len = op->w25qxx->page_size - (op->address & (op->w25qxx->page_size - 1));
+        write_len = op->end - op->address > write_len ? write_len : op->end - op->address;
 
-        W25_DBG("w25qxx_write: handling page %lu start_address = 0x%08lx buffer_offset = 0x%08lx len = %04lx", page, start_address, buffer_offset, write_len);
+        W25_DBG("w25qxx_write: start_address = 0x%08lx len = %04lx", op->address, write_len);
 
-        // First wait for device to get ready
-        if (w25qxx_wait_for_ready(w25qxx, HAL_MAX_DELAY) != W25QXX_Ok) {
-            return W25QXX_Err;
+        if (w25qxx_command(op->w25qxx, W25QXX_PAGE_PROGRAM, op->address, op->buf, write_len) != W25QXX_Ok) {
+            STM32_ASYNC_EXIT(async, -SDK_ERROR);
         }
+        op->address += write_len;
+        op->buf += write_len;
+    }
+    W25QXX_ASYNC_WAIT_READY(op);
+    STM32_ASYNC_END(async);
+}
 
-        if (w25qxx_write_enable(w25qxx) == W25QXX_Ok) {
+static int32_t w25qxx_erase_poll(stm32_async_t *async) {
+    W25QXX_async_t *op = (W25QXX_async_t *) async;
 
-            uint8_t tx[4] = {
-            W25QXX_PAGE_PROGRAM, (uint8_t) (start_address >> 16), (uint8_t) (start_address >> 8), (uint8_t) (start_address), };
+    STM32_ASYNC_BEGIN(async);
+    while (op->address < op->end) {
+        W25QXX_ASYNC_WAIT_READY(op);
 
-            cs_on(w25qxx);
-            if (w25qxx_transmit(w25qxx, tx, 4) == W25QXX_Ok) { // size will always be fixed
-                // Now write the buffer
-                if (w25qxx_transmit(w25qxx, buf + buffer_offset, write_len) != W25QXX_Ok) {
-                    cs_off(w25qxx);
-                    return W25QXX_Err;
-                }
-            }
-            cs_off(w25qxx);
+        W25_DBG("Erasing sector at: 0x%08lx", op->address);
+
+        if (w25qxx_command(op->w25qxx, W25QXX_SECTOR_ERASE, op->address, NULL, 0) != W25QXX_Ok) {
+            STM32_ASYNC_EXIT(async, -SDK_ERROR);
         }
-        start_address += write_len;
-        buffer_offset += write_len;
-        len -= write_len;
+        op->address += op->w25qxx->sector_size;
     }
-
-    return W25QXX_Ok;
+    W25QXX_ASYNC_WAIT_READY(op);
+    STM32_ASYNC_END(async);
 }
 
-W25QXX_result_t w25qxx_erase(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t len) {
+static int32_t w25qxx_chip_erase_poll(stm32_async_t *async) {
+    W25QXX_async_t *op = (W25QXX_async_t *) async;
 
-    W25_DBG("w25qxx_erase, address = 0x%08lx len = 0x%04lx", address, len);
+    STM32_ASYNC_BEGIN(async);
+    if (w25qxx_command(op->w25qxx, W25QXX_CHIP_ERASE, 0, NULL, 0) != W25QXX_Ok) {
+        STM32_ASYNC_EXIT(async, -SDK_ERROR);
+    }
+    W25QXX_ASYNC_WAIT_READY(op);
+    STM32_ASYNC_END(async);
+}
 
-    W25QXX_result_t ret = W25QXX_Ok;
+static stm32_dma_chan_t *w25qxx_dma_rx;
+static stm32_dma_chan_t *w25qxx_dma_tx;
+static volatile uint8_t w25qxx_dma_error;
 
-    // Let's determine the sector start
-    uint32_t first_sector = address / w25qxx->sector_size;
-    uint32_t last_sector = (address + len - 1) / w25qxx->sector_size;
+static void w25qxx_dma_callback(stm32_dma_chan_t *chan, uint32_t event, void *param) {
+    if (event == STM32_DMA_EVENT_ERROR) {
+        w25qxx_dma_error = 1;
+    }
+}
 
-    W25_DBG("w25qxx_erase: first sector: 0x%04lx", first_sector);W25_DBG("w25qxx_erase: last sector : 0x%04lx", last_sector);
+/* channels are requested once and kept; without them reads fall back to polling */
+static uint8_t w25qxx_dma_ready(void) {
+    if (w25qxx_dma_rx == NULL) {
+        w25qxx_dma_rx = stm32_dma_request(STM32_DMA_SPI1_RX, w25qxx_dma_callback, NULL);
+    }
+    if (w25qxx_dma_tx == NULL) {
+        w25qxx_dma_tx = stm32_dma_request(STM32_DMA_SPI1_TX, w25qxx_dma_callback, NULL);
+    }
+    return w25qxx_dma_rx != NULL && w25qxx_dma_tx != NULL;
+}
 
-    for (uint32_t sector = first_sector; sector <= last_sector; ++sector) {
+static uint32_t w25qxx_dma_chunk(W25QXX_async_t *op) {
+    return op->end - op->address > W25QXX_DMA_MAX ? W25QXX_DMA_MAX : op->end - op->address;
+}
 
-        W25_DBG("Erasing sector %lu, starting at: 0x%08lx", sector, sector * w25qxx->sector_size);
+static void w25qxx_dma_start(uint8_t *buf, uint16_t len) {
+    // drop what the command bytes left in the receiver
+    while (LL_SPI_IsActiveFlag_RXNE(SPI1)) {
+        (void) LL_SPI_ReceiveData8(SPI1);
+    }
+    LL_SPI_ClearFlag_OVR(SPI1);
+    w25qxx_dma_error = 0;
+
+    LL_SPI_EnableDMAReq_RX(SPI1);
+    stm32_dma_start(w25qxx_dma_rx, buf, len, 0);
+    // the device ignores MOSI while reading, so the clocking bytes come from buf itself:
+    // each one is sent before the byte received in its place is stored
+    stm32_dma_start(w25qxx_dma_tx, buf, len, 0);
+    LL_SPI_EnableDMAReq_TX(SPI1);
+}
 
-        // First we have to ensure the device is not busy
-        if (w25qxx_wait_for_ready(w25qxx, HAL_MAX_DELAY) == W25QXX_Ok) {
-            if (w25qxx_write_enable(w25qxx) == W25QXX_Ok) {
+static void w25qxx_dma_end(void) {
+    while (LL_SPI_IsActiveFlag_BSY(SPI1))
+        ;
+    LL_SPI_DisableDMAReq_TX(SPI1);
+    LL_SPI_DisableDMAReq_RX(SPI1);
+    stm32_dma_stop(w25qxx_dma_tx);
+    stm32_dma_stop(w25qxx_dma_rx);
+}
 
-                uint32_t sector_start_address = sector * w25qxx->sector_size;
+static int32_t w25qxx_read_poll(stm32_async_t *async) {
+    W25QXX_async_t *op = (W25QXX_async_t *) async;
+    W25QXX_result_t ret;
+    uint8_t tx[4];
+
+    STM32_ASYNC_BEGIN(async);
+    W25QXX_ASYNC_WAIT_READY(op);
+
+    tx[0] = W25QXX_READ_DATA;
+    tx[1] = (uint8_t) (op->address >> 16);
+    tx[2] = (uint8_t) (op->address >> 8);
+    tx[3] = (uint8_t) (op->address);
+    cs_on(op->w25qxx);
+    if (w25qxx_transmit(op->w25qxx, tx, 4) != W25QXX_Ok) {
+        cs_off(op->w25qxx);
+        STM32_ASYNC_EXIT(async, -SDK_ERROR);
+    }
 
-                uint8_t tx[4] = {
-                W25QXX_SECTOR_ERASE, (uint8_t) (sector_start_address >> 16), (uint8_t) (sector_start_address >> 8), (uint8_t) (sector_start_address), };
+    if (!w25qxx_dma_ready()) {
+        ret = w25qxx_receive(op->w25qxx, op->buf, op->end - op->address);
+        cs_off(op->w25qxx);
+        STM32_ASYNC_EXIT(async, ret == W25QXX_Ok ? SDK_OK : -SDK_ERROR);
+    }
 
-                cs_on(w25qxx);
-                if (w25qxx_transmit(w25qxx, tx, 4) != W25QXX_Ok) {
-                    ret = W25QXX_Err;
-                }
-                cs_off(w25qxx);
-            }
-        } else {
-            ret = W25QXX_Timeout;
+    // one READ_DATA command streams the whole range, chip select stays low between chunks
+    while (op->address < op->end) {
+        w25qxx_dma_start(op->buf, w25qxx_dma_chunk(op));
+        STM32_ASYNC_WAIT_UNTIL(async, !w25qxx_dma_rx->busy);
+        w25qxx_dma_end();
+        if (w25qxx_dma_error) {
+            cs_off(op->w25qxx);
+            STM32_ASYNC_EXIT(async, -SDK_ERROR);
         }
+        op->buf += w25qxx_dma_chunk(op);
+        op->address += w25qxx_dma_chunk(op);
+    }
+    cs_off(op->w25qxx);
+    STM32_ASYNC_END(async);
+}
 
+/*
+ * Every operation runs through here: it takes the device on its first step
+ * and gives it back when it completes, a read holding chip select low and
+ * the SPI1 DMA channels in between.
+ */
+static int32_t w25qxx_poll(stm32_async_t *async) {
+    W25QXX_async_t *op = (W25QXX_async_t *) async;
+    W25QXX_HandleTypeDef *w25qxx = op->w25qxx;
+    int32_t result;
+
+    if (w25qxx->owner != NULL && w25qxx->owner != op) {
+        return STM32_ASYNC_PENDING;
     }
+    w25qxx->owner = op;
+    result = op->step(async);
+    if (result != STM32_ASYNC_PENDING) {
+        w25qxx->owner = NULL;
+    }
+    return result;
+}
 
-    return ret;
+static W25QXX_result_t w25qxx_async_start(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t end, uint8_t *buf,
+                                          stm32_async_poll_t poll, stm32_async_done_t done, void *param) {
+    // a running op is still using its fields
+    if (op->async.status == STM32_ASYNC_RUNNING) {
+        return W25QXX_Err;
+    }
+    op->step = poll;
+    op->w25qxx = w25qxx;
+    op->address = address;
+    op->end = end;
+    op->buf = buf;
+    op->timeout = 0;
+    if (stm32_async_start(&op->async, w25qxx_poll, done, param) != SDK_OK) {
+        return W25QXX_Err;
+    }
+    return W25QXX_Ok;
+}
+
+static int32_t w25qxx_async_wait(W25QXX_async_t *op) {
+    w25qxx_wait_idle(op->w25qxx);
+    return stm32_async_wait(&op->async);
+}
+
+static W25QXX_result_t w25qxx_async_result(int32_t result) {
+    if (result == SDK_OK) {
+        return W25QXX_Ok;
+    }
+    return result == -SDK_E_TIMEOUT ? W25QXX_Timeout : W25QXX_Err;
+}
+
+W25QXX_result_t w25qxx_read_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len,
+                                  stm32_async_done_t done, void *param) {
+    W25_DBG("w25qxx_read_async - address 0x%08lx len 0x%04lx", address, len);
+    return w25qxx_async_start(op, w25qxx, address, address + len, buf, w25qxx_read_poll, done, param);
+}
+
+W25QXX_result_t w25qxx_write_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len,
+                                   stm32_async_done_t done, void *param) {
+    W25_DBG("w25qxx_write - address 0x%08lx len 0x%04lx", address, len);
+    return w25qxx_async_start(op, w25qxx, address, address + len, buf, w25qxx_write_poll, done, param);
+}
+
+W25QXX_result_t w25qxx_erase_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t len,
+                                   stm32_async_done_t done, void *param) {
+    W25_DBG("w25qxx_erase, address = 0x%08lx len = 0x%04lx", address, len);
+    // whole sectors covering the range
+    uint32_t start = address / w25qxx->sector_size * w25qxx->sector_size;
+    return w25qxx_async_start(op, w25qxx, start, address + len, NULL, w25qxx_erase_poll, done, param);
+}
+
+W25QXX_result_t w25qxx_chip_erase_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, stm32_async_done_t done, void *param) {
+    return w25qxx_async_start(op, w25qxx, 0, 0, NULL, w25qxx_chip_erase_poll, done, param);
+}
+
+W25QXX_result_t w25qxx_write(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len) {
+    W25QXX_async_t op = {0};
+
+    if (w25qxx_write_async(&op, w25qxx, address, buf, len, NULL, NULL) != W25QXX_Ok) {
+        return W25QXX_Err;
+    }
+    return w25qxx_async_result(w25qxx_async_wait(&op));
+}
+
+W25QXX_result_t w25qxx_erase(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t len) {
+    W25QXX_async_t op = {0};
+
+    if (w25qxx_erase_async(&op, w25qxx, address, len, NULL, NULL) != W25QXX_Ok) {
+        return W25QXX_Err;
+    }
+    return w25qxx_async_result(w25qxx_async_wait(&op));
 }
 
 W25QXX_result_t w25qxx_chip_erase(W25QXX_HandleTypeDef *w25qxx) {
-    if (w25qxx_write_enable(w25qxx) == W25QXX_Ok) {
-        uint8_t tx[1] = {
-        W25QXX_CHIP_ERASE };
-        cs_on(w25qxx);
-        if (w25qxx_transmit(w25qxx, tx, 1) != W25QXX_Ok) {
-            return W25QXX_Err;
-        }
-        cs_off(w25qxx);
-        if (w25qxx_wait_for_ready(w25qxx, HAL_MAX_DELAY) != W25QXX_Ok) {
-            return W25QXX_Err;
-        }
+    W25QXX_async_t op = {0};
+
+    if (w25qxx_chip_erase_async(&op, w25qxx, NULL, NULL) != W25QXX_Ok) {
+        return W25QXX_Err;
     }
-    return W25QXX_Ok;
+    return w25qxx_async_result(w25qxx_async_wait(&op));
 }
 
 /*
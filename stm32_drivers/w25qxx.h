@@ -30,6 +30,10 @@
 #define W25QXX_CHIP_ERASE         0xc7
 #define W25QXX_READ_REGISTER_1    0x05
 
+#include "stm32_async.h"
+
+struct W25QXX_async;
+
 typedef struct {
 #ifdef W25QXX_QSPI
     QSPI_HandleTypeDef *qspiHandle;
@@ -46,6 +50,7 @@ typedef struct {
     uint32_t sectors_in_block;
     uint32_t page_size;
     uint32_t pages_in_sector;
+    struct W25QXX_async *owner;     // operation using the bus, NULL when free
 } W25QXX_HandleTypeDef;
 
 typedef enum {
@@ -64,6 +69,37 @@ W25QXX_result_t w25qxx_write(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uin
 W25QXX_result_t w25qxx_erase(W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t len);
 W25QXX_result_t w25qxx_chip_erase(W25QXX_HandleTypeDef *w25qxx);
 
+/*
+ * Non blocking variants run by stm32_async_poll. They complete, with SDK_OK,
+ * -SDK_ERROR or -SDK_E_TIMEOUT, once the device is idle again; buf must stay
+ * valid until then. The blocking write and erase calls above wrap them. The
+ * read moves its data with the SPI1 DMA channels, so the CPU is free while
+ * it runs; it polls the bytes in when the channels are taken.
+ *
+ * One operation owns the device from its first step until it completes,
+ * the others wait for it. The blocking calls step the owner to its end
+ * first, so its continuation may run inside them. A running operation must
+ * not be cancelled, it would keep the device.
+ */
+typedef struct W25QXX_async {
+    stm32_async_t async;
+    stm32_async_poll_t step;        // the operation itself, run while it owns the device
+    W25QXX_HandleTypeDef *w25qxx;
+    uint32_t address;
+    uint32_t end;
+    uint8_t *buf;
+    uint32_t begin;
+    uint8_t timeout;
+} W25QXX_async_t;
+
+W25QXX_result_t w25qxx_read_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len,
+                                  stm32_async_done_t done, void *param);
+W25QXX_result_t w25qxx_write_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint8_t *buf, uint32_t len,
+                                   stm32_async_done_t done, void *param);
+W25QXX_result_t w25qxx_erase_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, uint32_t address, uint32_t len,
+                                   stm32_async_done_t done, void *param);
+W25QXX_result_t w25qxx_chip_erase_async(W25QXX_async_t *op, W25QXX_HandleTypeDef *w25qxx, stm32_async_done_t done, void *param);
+
 #endif /* W25QXX_H_ */
 
 /*
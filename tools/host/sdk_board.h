@@ -0,0 +1,103 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __SDK_BOARD_H
+#define __SDK_BOARD_H
+
+/*
+ * Just enough of sdk_board.h and CMSIS for the pure logic driver files to
+ * build on a host, for the benchmarks in tools/. Put tools/host first on
+ * the include path.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SDK_SYSTICK_PER_SECOND  1000
+
+typedef int32_t sdk_err_t;
+
+/* program flash of the STM32L072, the settings check maps RAM over its top */
+#define MCU_FLASH_PAGE_SIZE     128
+#define MCU_FLASH_START_ADRESS  0x08000000UL
+#define MCU_FLASH_END_ADDRESS   0x08030000UL
+
+#define SDK_OK                  0
+#define SDK_ERROR               1
+#define SDK_E_TIMEOUT           2
+#define SDK_E_INVALID           3
+
+#define __WEAK                  __attribute__((weak))
+
+/* SysTick and PRIMASK do nothing on the host, the benchmarks run one thread */
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_ENABLE_Msk     (1UL << 0)
+#define SysTick_CTRL_TICKINT_Msk    (1UL << 1)
+
+extern SysTick_Type host_systick;
+#ifdef HOST_SYSTICK_CLOCKED
+/* every register access is one SysTick clock, the caller models the counter */
+SysTick_Type *host_systick_clock(void);
+#define SysTick                 (host_systick_clock())
+#else
+#define SysTick                 (&host_systick)
+#endif
+
+typedef struct
+{
+    volatile uint32_t ICSR;
+} SCB_Type;
+
+#define SCB_ICSR_PENDSTSET_Msk  (1UL << 26)
+
+extern SCB_Type host_scb;
+#define SCB                     (&host_scb)
+
+typedef enum
+{
+    LPTIM1_IRQn = 13,
+} IRQn_Type;
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+static inline void __DSB(void) { }
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { (void)irq; }
+static inline void NVIC_ClearPendingIRQ(IRQn_Type irq) { (void)irq; }
+
+/* the sleep itself, provided by the program that simulates the wakeup */
+void __WFI(void);
+
+/* RTC_TR and RTC_DR fields, as in stm32l0xx.h */
+#define RTC_TR_SU_Pos           0U
+#define RTC_TR_SU               (0xFUL << RTC_TR_SU_Pos)
+#define RTC_TR_ST               (0x7UL << 4U)
+#define RTC_TR_MNU_Pos          8U
+#define RTC_TR_MNU              (0xFUL << RTC_TR_MNU_Pos)
+#define RTC_TR_MNT              (0x7UL << 12U)
+#define RTC_TR_HU_Pos           16U
+#define RTC_TR_HU               (0xFUL << RTC_TR_HU_Pos)
+#define RTC_TR_HT               (0x3UL << 20U)
+#define RTC_DR_DU_Pos           0U
+#define RTC_DR_DU               (0xFUL << RTC_DR_DU_Pos)
+#define RTC_DR_DT               (0x3UL << 4U)
+#define RTC_DR_MU_Pos           8U
+#define RTC_DR_MU               (0xFUL << RTC_DR_MU_Pos)
+#define RTC_DR_MT               (0x1UL << 12U)
+#define RTC_DR_YU_Pos           16U
+#define RTC_DR_YU               (0xFUL << RTC_DR_YU_Pos)
+#define RTC_DR_YT               (0xFUL << 20U)
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __SDK_FLASH_H
+#define __SDK_FLASH_H
+
+#include "sdk_board.h"
+
+/* the flash device interface of the SDK, as the drivers use it */
+typedef struct sdk_flash sdk_flash_t;
+
+struct sdk_flash
+{
+    struct
+    {
+        sdk_err_t (*open)(sdk_flash_t *flash);
+        sdk_err_t (*close)(sdk_flash_t *flash);
+        int32_t (*read)(sdk_flash_t *flash, uint32_t addr, uint8_t *buf, size_t size);
+        int32_t (*write)(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf, size_t size);
+        sdk_err_t (*erase)(sdk_flash_t *flash, uint32_t addr, size_t size);
+        sdk_err_t (*control)(sdk_flash_t *flash, int32_t cmd, void *args);
+    } ops;
+};
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __SDK_LOG_H
+#define __SDK_LOG_H
+
+#include <stdio.h>
+
+/* errors and warnings go to stdout with the tag, the rest is dropped */
+#define LOG_E(fmt, ...)         printf("E/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#define LOG_W(fmt, ...)         printf("W/" DBG_TAG ": " fmt, ##__VA_ARGS__)
+#define LOG_I(fmt, ...)         ((void)0)
+#define LOG_D(fmt, ...)         ((void)0)
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __SDK_RTC_H
+#define __SDK_RTC_H
+
+/* stm32_rtc.h only needs the name on the host, see sdk_board.h here */
+
+#endif
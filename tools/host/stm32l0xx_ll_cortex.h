@@ -0,0 +1,13 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32L0xx_LL_CORTEX_H
+#define __STM32L0xx_LL_CORTEX_H
+
+#define LL_LPM_EnableSleep()                    ((void)0)
+#define LL_LPM_EnableDeepSleep()                ((void)0)
+
+#endif
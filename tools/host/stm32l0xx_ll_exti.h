@@ -0,0 +1,14 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32L0xx_LL_EXTI_H
+#define __STM32L0xx_LL_EXTI_H
+
+#define LL_EXTI_LINE_29                         (1UL << 29)
+
+#define LL_EXTI_EnableIT_0_31(lines)            ((void)(lines))
+
+#endif
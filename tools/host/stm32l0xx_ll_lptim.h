@@ -0,0 +1,64 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32L0xx_LL_LPTIM_H
+#define __STM32L0xx_LL_LPTIM_H
+
+/*
+ * LPTIM1 as stm32_lowpower.c uses it: the counter and the enable bit are
+ * state the caller sets, the rest of the setup does nothing. The bus and
+ * RCC calls that come with sdk_board.h on the target are here as well.
+ */
+
+typedef struct
+{
+    uint32_t CNT;
+    uint32_t CMP;
+    uint32_t ARR;
+    uint32_t enabled;
+} LPTIM_TypeDef;
+
+extern LPTIM_TypeDef host_lptim;
+#define LPTIM1                                  (&host_lptim)
+
+#define LL_APB1_GRP1_PERIPH_LPTIM1              0
+#define LL_RCC_LPTIM1_CLKSOURCE_LSI             0
+#define LL_RCC_LPTIM1_CLKSOURCE_LSE             1
+#define LL_LPTIM_CLK_SOURCE_INTERNAL            0
+#define LL_LPTIM_PRESCALER_DIV1                 0
+#define LL_LPTIM_PRESCALER_DIV8                 3
+#define LL_LPTIM_COUNTER_MODE_INTERNAL          0
+#define LL_LPTIM_UPDATE_MODE_IMMEDIATE          0
+#define LL_LPTIM_OPERATING_MODE_CONTINUOUS      0
+
+#define LL_APB1_GRP1_EnableClock(periph)        ((void)(periph))
+#define LL_RCC_SetLPTIMClockSource(source)      ((void)(source))
+#define LL_LPTIM_SetClockSource(t, source)      ((void)(source))
+#define LL_LPTIM_SetPrescaler(t, prescaler)     ((void)(prescaler))
+#define LL_LPTIM_SetCounterMode(t, mode)        ((void)(mode))
+#define LL_LPTIM_SetUpdateMode(t, mode)         ((void)(mode))
+#define LL_LPTIM_TrigSw(t)                      ((void)(t))
+#define LL_LPTIM_EnableIT_CMPM(t)               ((void)(t))
+#define LL_LPTIM_DisableIT_ARRM(t)              ((void)(t))
+#define LL_LPTIM_IsEnabledIT_ARRM(t)            0
+#define LL_LPTIM_ClearFlag_ARROK(t)             ((void)(t))
+#define LL_LPTIM_ClearFlag_CMPOK(t)             ((void)(t))
+#define LL_LPTIM_ClearFLAG_ARRM(t)              ((void)(t))
+#define LL_LPTIM_ClearFLAG_CMPM(t)              ((void)(t))
+#define LL_LPTIM_IsActiveFlag_ARROK(t)          1
+#define LL_LPTIM_IsActiveFlag_CMPOK(t)          1
+#define LL_LPTIM_IsActiveFlag_ARRM(t)           0
+#define LL_LPTIM_IsActiveFlag_CMPM(t)           0
+
+static inline void LL_LPTIM_Enable(LPTIM_TypeDef *t) { t->enabled = 1; }
+static inline void LL_LPTIM_Disable(LPTIM_TypeDef *t) { t->enabled = 0; }
+static inline uint32_t LL_LPTIM_IsEnabled(LPTIM_TypeDef *t) { return t->enabled; }
+static inline void LL_LPTIM_SetAutoReload(LPTIM_TypeDef *t, uint32_t arr) { t->ARR = arr; }
+static inline void LL_LPTIM_SetCompare(LPTIM_TypeDef *t, uint32_t cmp) { t->CMP = cmp; }
+static inline void LL_LPTIM_StartCounter(LPTIM_TypeDef *t, uint32_t mode) { (void)mode; t->CNT = 0; }
+static inline uint32_t LL_LPTIM_GetCounter(LPTIM_TypeDef *t) { return t->CNT; }
+
+#endif
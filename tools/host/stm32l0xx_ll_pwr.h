@@ -0,0 +1,15 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+#ifndef __STM32L0xx_LL_PWR_H
+#define __STM32L0xx_LL_PWR_H
+
+#define LL_PWR_MODE_STOP                        1
+
+#define LL_PWR_ClearFlag_WU()                   ((void)0)
+#define LL_PWR_SetPowerMode(mode)               ((void)(mode))
+
+#endif
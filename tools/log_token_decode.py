@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+Decode tokenized log frames produced with STM32_LOG_USING_TOKEN.
+
+Frame layout (little endian):
+    0xA5 | nargs | token (u32) | systick (u32) | args (u32) * nargs
+
+The token is the address of the format string in the .logstr section of the
+ELF. Bytes outside frames are passed through as text, so a stream that mixes
+printf output and tokenized frames decodes as well.
+
+Usage:
+    log_token_decode.py firmware.elf [capture.bin]     (stdin when omitted)
+
+Requires pyelftools.
+"""
+
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+SYNC = 0xA5
+MAX_ARGS = 8
+HDR_SIZE = 10
+
+FMT_RE = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+))?(hh|h|ll|l|j|z|t|L)?([diouxXcspf%])")
+
+
+class Image:
+    def __init__(self, path):
+        self.f = open(path, "rb")
+        self.elf = ELFFile(self.f)
+        self.logstr = self.elf.get_section_by_name(".logstr")
+        self.sections = [s for s in self.elf.iter_sections()
+                         if s["sh_flags"] & 0x2 and s["sh_type"] != "SHT_NOBITS"]
+
+    def format_at(self, token):
+        if self.logstr is None:
+            return None
+        return self._string_in([self.logstr], token)
+
+    def string_at(self, addr):
+        return self._string_in(self.sections, addr)
+
+    @staticmethod
+    def _string_in(sections, addr):
+        for sec in sections:
+            start = sec["sh_addr"]
+            if start <= addr < start + sec["sh_size"]:
+                data = sec.data()[addr - start:]
+                return data.split(b"\0", 1)[0].decode("utf-8", "replace")
+        return None
+
+
+def render(image, fmt, args):
+    out = []
+    pos = 0
+    it = iter(args)
+    for m in FMT_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        value = next(it, 0)
+        if width == "*":
+            width = str(value)
+            value = next(it, 0)
+        if conv == "s":
+            text = image.string_at(value)
+            out.append(text if text is not None else "<0x%08x>" % value)
+            continue
+        if conv == "p":
+            out.append("0x%08x" % value)
+            continue
+        if conv in "di":
+            value = struct.unpack("<i", struct.pack("<I", value))[0]
+        elif conv == "u":
+            conv = "d"
+        elif conv == "f":
+            out.append("<float>")
+            continue
+        spec = "%" + (flags or "") + (width or "") + ("." + prec if prec else "") + conv
+        out.append(spec % value)
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(image, stream, write):
+    buf = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+        while buf:
+            if buf[0] != SYNC:
+                end = buf.find(bytes([SYNC]))
+                end = len(buf) if end < 0 else end
+                write(buf[:end].decode("utf-8", "replace"))
+                buf = buf[end:]
+                continue
+            if len(buf) < 2:
+                break
+            nargs = buf[1]
+            if nargs > MAX_ARGS:
+                write(buf[:1].decode("latin-1"))
+                buf = buf[1:]
+                continue
+            size = HDR_SIZE + 4 * nargs
+            if len(buf) < size:
+                break
+            token, tick = struct.unpack_from("<II", buf, 2)
+            args = struct.unpack_from("<%dI" % nargs, buf, HDR_SIZE)
+            fmt = image.format_at(token)
+            if fmt is None:
+                # not a frame after all, resync on the next byte
+                write(buf[:1].decode("latin-1"))
+                buf = buf[1:]
+                continue
+            line = render(image, fmt, args)
+            write("[%u] %s%s" % (tick, line, "" if line.endswith("\n") else "\n"))
+            buf = buf[size:]
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    image = Image(sys.argv[1])
+    stream = open(sys.argv[2], "rb") if len(sys.argv) > 2 else sys.stdin.buffer
+    decode(image, stream, sys.stdout.write)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,123 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Host benchmark of stm32_rtc_unix_time, the conversion behind
+ * stm32_rtc_get_time, against the mktime path of SDK_CONTROL_RTC_GET_TIME.
+ * Every calendar value from 2000 to 2099 at a coarse step is converted both
+ * ways and checked against the time it was built from, then both are timed.
+ *
+ * Build and run from the repository root:
+ *     cc -O2 -Itools/host -Istm32_drivers tools/rtc_bench.c -o rtc_bench
+ *     ./rtc_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sdk_board.h"
+#include "stm32_rtc.h"
+
+#define BENCH_SAMPLES       100000
+#define BENCH_ROUNDS        20
+
+static uint32_t bench_tr[BENCH_SAMPLES];
+static uint32_t bench_dr[BENCH_SAMPLES];
+
+static uint32_t bench_bcd(uint32_t value)
+{
+    return ((value / 10) << 4) | (value % 10);
+}
+
+static double bench_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* as get_rtc_timestamp in stm32_rtc.c */
+static uint32_t bench_mktime(uint32_t tr, uint32_t dr)
+{
+    struct tm tm_new = {0};
+
+    tm_new.tm_sec  = stm32_rtc_bcd((tr & (RTC_TR_ST | RTC_TR_SU)) >> RTC_TR_SU_Pos);
+    tm_new.tm_min  = stm32_rtc_bcd((tr & (RTC_TR_MNT | RTC_TR_MNU)) >> RTC_TR_MNU_Pos);
+    tm_new.tm_hour = stm32_rtc_bcd((tr & (RTC_TR_HT | RTC_TR_HU)) >> RTC_TR_HU_Pos);
+    tm_new.tm_mday = stm32_rtc_bcd((dr & (RTC_DR_DT | RTC_DR_DU)) >> RTC_DR_DU_Pos);
+    tm_new.tm_mon  = stm32_rtc_bcd((dr & (RTC_DR_MT | RTC_DR_MU)) >> RTC_DR_MU_Pos) - 1;
+    tm_new.tm_year = stm32_rtc_bcd((dr & (RTC_DR_YT | RTC_DR_YU)) >> RTC_DR_YU_Pos) + 100;
+
+    return (uint32_t)mktime(&tm_new);
+}
+
+int main(void)
+{
+    volatile uint32_t sink = 0;
+    uint32_t count = 0;
+    uint32_t bad = 0;
+    double start, slow, fast;
+    time_t t;
+    uint32_t i, r;
+
+    /* the RTC holds UTC, so does mktime here */
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    /* 2000-01-01 to 2099-12-31, a step that walks through every hour, minute and month */
+    for (t = 946684800; t < 4102444800LL; t += 37 * 3600 + 1234)
+    {
+        struct tm *tm = gmtime(&t);
+        uint32_t tr = (bench_bcd(tm->tm_hour) << 16) | (bench_bcd(tm->tm_min) << 8) | bench_bcd(tm->tm_sec);
+        uint32_t dr = (bench_bcd(tm->tm_year - 100) << 16) | (bench_bcd(tm->tm_mon + 1) << 8) | bench_bcd(tm->tm_mday);
+
+        if (stm32_rtc_unix_time(tr, dr) != (uint32_t)t || bench_mktime(tr, dr) != (uint32_t)t)
+        {
+            if (bad++ < 5)
+            {
+                printf("mismatch at %lld: fast %u, mktime %u\n", (long long)t, stm32_rtc_unix_time(tr, dr), bench_mktime(tr, dr));
+            }
+        }
+        if (count < BENCH_SAMPLES)
+        {
+            bench_tr[count] = tr;
+            bench_dr[count] = dr;
+        }
+        count++;
+    }
+    if (count > BENCH_SAMPLES)
+    {
+        count = BENCH_SAMPLES;
+    }
+
+    start = bench_ns();
+    for (r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            sink += bench_mktime(bench_tr[i], bench_dr[i]);
+        }
+    }
+    slow = bench_ns() - start;
+
+    start = bench_ns();
+    for (r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            sink += stm32_rtc_unix_time(bench_tr[i], bench_dr[i]);
+        }
+    }
+    fast = bench_ns() - start;
+
+    printf("%u calendar values, %u mismatches\n", count, bad);
+    printf("  mktime              %8.1f ns/call\n", slow / (BENCH_ROUNDS * count));
+    printf("  stm32_rtc_unix_time %8.1f ns/call\n", fast / (BENCH_ROUNDS * count));
+
+    return bad != 0;
+}
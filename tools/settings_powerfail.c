@@ -0,0 +1,257 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Host check of stm32_settings against power loss. Program flash is modelled
+ * at its address on the target: a word is only programmed while erased, a
+ * cut write leaves the word with part of its bits, a cut erase leaves the
+ * page partly erased. Random writes are cut at random points; after each cut
+ * the store is initialised again, as after a reset, and every key must read
+ * either its new or its old value, and the others their last value. Then
+ * the index is filled, and a new key must reclaim the slot of a deleted one.
+ *
+ * Build and run from the repository root:
+ *     cc -O2 -Itools/host -Istm32_drivers tools/settings_powerfail.c stm32_drivers/stm32_settings.c -o settings_powerfail
+ *     ./settings_powerfail [seed] [writes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <sys/mman.h>
+
+#include "sdk_board.h"
+#include "sdk_flash.h"
+#include "stm32_flash.h"
+#include "stm32_settings.h"
+
+#define CHECK_MAP_START     (STM32_SETTINGS_ADDRESS & ~0xFFFUL)
+#define CHECK_MAP_SIZE      (MCU_FLASH_END_ADDRESS - CHECK_MAP_START)
+#define CHECK_KEYS          20
+#define CHECK_LEN_MAX       40
+
+static jmp_buf check_cut;
+static long check_budget = -1;      /* word writes and page erases left before the cut, -1 for none */
+static uint32_t check_seed = 1;
+
+static uint8_t check_val[CHECK_KEYS][CHECK_LEN_MAX];
+static int32_t check_len[CHECK_KEYS];
+
+static uint32_t check_rand(void)
+{
+    check_seed = check_seed * 1664525 + 1013904223;
+    return check_seed >> 8;
+}
+
+/* counts one flash operation, and ends the write here when it is the one cut */
+static int check_cut_now(void)
+{
+    if (check_budget == 0)
+    {
+        return 1;
+    }
+    if (check_budget > 0)
+    {
+        check_budget--;
+    }
+    return 0;
+}
+
+static int32_t check_flash_write(sdk_flash_t *flash, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    uint8_t data[STM32_SETTINGS_LEN_MAX + 8];
+    uint32_t word, old, new;
+    size_t i = 0;
+
+    (void)flash;
+    /* the source may be the flash being written, during a compaction */
+    memcpy(data, buf, size);
+    while (i < size)
+    {
+        word = (addr + i) & ~3UL;
+        old = *(uint32_t *)(uintptr_t)word;
+        new = old;
+        for (; i < size && ((addr + i) & ~3UL) == word; i++)
+        {
+            ((uint8_t *)&new)[(addr + i) & 3] = data[i];
+        }
+        if (new == old)
+        {
+            continue;
+        }
+        if (old != STM32_FLASH_ERASED_WORD)
+        {
+            printf("write over programmed word at 0x%08x\n", word);
+            exit(1);
+        }
+        if (check_cut_now())
+        {
+            *(uint32_t *)(uintptr_t)word = new & (check_rand() | (check_rand() << 16));
+            longjmp(check_cut, 1);
+        }
+        *(uint32_t *)(uintptr_t)word = new;
+    }
+    return (int32_t)size;
+}
+
+static sdk_err_t check_flash_erase(sdk_flash_t *flash, uint32_t addr, size_t size)
+{
+    uint32_t page, i;
+
+    (void)flash;
+    for (page = addr; page < addr + size; page += MCU_FLASH_PAGE_SIZE)
+    {
+        if (check_cut_now())
+        {
+            for (i = 0; i < MCU_FLASH_PAGE_SIZE; i += 4)
+            {
+                *(uint32_t *)(uintptr_t)(page + i) &= check_rand() | (check_rand() << 16);
+            }
+            longjmp(check_cut, 1);
+        }
+        memset((void *)(uintptr_t)page, STM32_FLASH_ERASED_WORD, MCU_FLASH_PAGE_SIZE);
+    }
+    return SDK_OK;
+}
+
+sdk_flash_t stm32_onchip_flash =
+{
+    .ops.write = check_flash_write,
+    .ops.erase = check_flash_erase,
+};
+
+static uint32_t check_all(void)
+{
+    uint8_t buf[CHECK_LEN_MAX];
+    uint32_t bad = 0;
+    int32_t len;
+    uint16_t key;
+
+    for (key = 0; key < CHECK_KEYS; key++)
+    {
+        len = stm32_settings_get(key, buf, sizeof(buf));
+        if (len != check_len[key] || memcmp(buf, check_val[key], len) != 0)
+        {
+            printf("key %u reads %d bytes, expected %d\n", key, len, check_len[key]);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static uint32_t check_powerfail(uint32_t writes, uint32_t *cuts)
+{
+    uint8_t data[CHECK_LEN_MAX], old[CHECK_LEN_MAX], buf[CHECK_LEN_MAX];
+    int32_t len, old_len;
+    uint32_t bad = 0;
+    uint32_t i;
+    uint16_t key;
+    sdk_err_t result;
+
+    for (i = 0; i < writes && bad == 0; i++)
+    {
+        key = check_rand() % CHECK_KEYS;
+        len = check_rand() % 3 == 0 ? 0 : 1 + check_rand() % CHECK_LEN_MAX;
+        for (old_len = 0; old_len < len; old_len++)
+        {
+            data[old_len] = (uint8_t)check_rand();
+        }
+
+        old_len = check_len[key];
+        memcpy(old, check_val[key], CHECK_LEN_MAX);
+        check_len[key] = len;
+        memcpy(check_val[key], data, len);
+
+        check_budget = check_rand() % 3 == 0 ? (long)(check_rand() % 40) : -1;
+        if (setjmp(check_cut) == 0)
+        {
+            result = len == 0 ? stm32_settings_delete(key) : stm32_settings_set(key, data, len);
+            check_budget = -1;
+            if (result != SDK_OK)
+            {
+                printf("write %u of key %u failed, %d\n", i, key, result);
+                return bad + 1;
+            }
+        }
+        else
+        {
+            /* reset: either value of the key is fine, the scan decides which */
+            check_budget = -1;
+            (*cuts)++;
+            stm32_settings_init();
+            if (stm32_settings_get(key, buf, sizeof(buf)) == old_len && memcmp(buf, old, old_len) == 0)
+            {
+                check_len[key] = old_len;
+                memcpy(check_val[key], old, CHECK_LEN_MAX);
+            }
+        }
+
+        if (check_rand() % 50 == 0)
+        {
+            stm32_settings_init();
+        }
+        bad += check_all();
+    }
+    return bad;
+}
+
+/* fill the index, then a new key only fits once one is deleted */
+static uint32_t check_index_full(void)
+{
+    uint8_t value = 7;
+    uint16_t key;
+    uint32_t bad = 0;
+
+    memset((void *)(uintptr_t)STM32_SETTINGS_ADDRESS, STM32_FLASH_ERASED_WORD, 2 * STM32_SETTINGS_BANK_SIZE);
+    stm32_settings_init();
+    for (key = 0; key < STM32_SETTINGS_MAX_KEYS; key++)
+    {
+        bad += stm32_settings_set(key, &value, 1) != SDK_OK;
+    }
+    bad += stm32_settings_set(STM32_SETTINGS_MAX_KEYS, &value, 1) == SDK_OK;
+    bad += stm32_settings_delete(1) != SDK_OK;
+    bad += stm32_settings_set(STM32_SETTINGS_MAX_KEYS, &value, 1) != SDK_OK;
+
+    stm32_settings_init();
+    bad += stm32_settings_get(1, &value, 1) != 0;
+    bad += stm32_settings_get(STM32_SETTINGS_MAX_KEYS, &value, 1) != 1;
+    for (key = 0; key < STM32_SETTINGS_MAX_KEYS; key++)
+    {
+        bad += key != 1 && stm32_settings_get(key, &value, 1) != 1;
+    }
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seed = argc > 1 ? strtoul(argv[1], NULL, 0) : 1;
+    uint32_t writes = argc > 2 ? strtoul(argv[2], NULL, 0) : 20000;
+    uint32_t cuts = 0;
+    uint32_t bad, full;
+    void *map;
+
+    check_seed = seed;
+    map = mmap((void *)CHECK_MAP_START, CHECK_MAP_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (map != (void *)CHECK_MAP_START)
+    {
+        printf("cannot map flash at 0x%08lx\n", CHECK_MAP_START);
+        return 1;
+    }
+
+    if (stm32_settings_init() != SDK_OK)
+    {
+        printf("init of blank flash failed\n");
+        return 1;
+    }
+    bad = check_powerfail(writes, &cuts);
+    full = check_index_full();
+
+    printf("seed %u: %u writes, %u cut by power loss, %u bad reads\n", seed, writes, cuts, bad);
+    printf("  full index: %s\n", full == 0 ? "deleted slot reclaimed" : "failed");
+
+    return (bad == 0 && full == 0) ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Host check of stm32_tickless_idle against a cycle model of SysTick and
+ * LPTIM1: the time base of stm32_get_time_us must never go backwards across
+ * a sleep, also when an interrupt ends it before one LPTIM count, and must
+ * not drift from the simulated time over thousands of sleeps.
+ *
+ * Build and run from the repository root:
+ *     cc -O2 -DHOST_SYSTICK_CLOCKED -Itools/host -Istm32_drivers tools/tickless_check.c \
+ *        stm32_drivers/stm32_lowpower.c stm32_drivers/stm32_timer.c -o tickless_check
+ *     ./tickless_check [sleeps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sdk_board.h"
+#include "stm32l0xx_ll_lptim.h"
+#include "stm32_common.h"
+#include "stm32_timer.h"
+#include "stm32_lowpower.h"
+
+#define CHECK_RELOAD        2096    /* 2.097 MHz MSI, 1 kHz systick */
+#define CHECK_LPTIM_HZ      (STM32_TICKLESS_CLOCK_HZ / 8)
+
+SysTick_Type host_systick;
+SCB_Type host_scb;
+LPTIM_TypeDef host_lptim;
+volatile uint32_t systicks;
+
+static double check_cycles;         /* simulated time while SysTick runs or the core sleeps */
+static uint32_t check_seed = 1;
+
+static uint32_t check_rand(void)
+{
+    check_seed = check_seed * 1664525 + 1013904223;
+    return check_seed >> 8;
+}
+
+stm32_critical_t stm32_critical_enter(void)
+{
+    return 0;
+}
+
+void stm32_critical_exit(stm32_critical_t state)
+{
+    (void)state;
+}
+
+void stm32_stop_resume_clock(void)
+{
+}
+
+/* VAL reloads from LOAD on the clock after it reads 0, and pends the tick on reaching 0 */
+SysTick_Type *host_systick_clock(void)
+{
+    if (host_systick.CTRL & SysTick_CTRL_ENABLE_Msk)
+    {
+        check_cycles++;
+        if (host_systick.VAL == 0)
+        {
+            host_systick.VAL = host_systick.LOAD;
+        }
+        else if (--host_systick.VAL == 0 && (host_systick.CTRL & SysTick_CTRL_TICKINT_Msk))
+        {
+            host_scb.ICSR |= SCB_ICSR_PENDSTSET_Msk;
+        }
+    }
+    return &host_systick;
+}
+
+/* early wakeups, most of them before the first count, the rest on the compare or late */
+void __WFI(void)
+{
+    uint32_t pick = check_rand() % 4;
+
+    if (!host_lptim.enabled)
+    {
+        host_systick_clock();
+        return;
+    }
+    if (pick == 0)
+    {
+        host_lptim.CNT = 0;
+    }
+    else if (pick == 1)
+    {
+        host_lptim.CNT = check_rand() % (host_lptim.CMP + 1);
+    }
+    else
+    {
+        host_lptim.CNT = host_lptim.CMP + check_rand() % 3;
+    }
+    check_cycles += (double)host_lptim.CNT * (CHECK_RELOAD + 1) * SDK_SYSTICK_PER_SECOND / CHECK_LPTIM_HZ;
+}
+
+static void check_systick_handler(void)
+{
+    if (host_scb.ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        host_scb.ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+        systicks++;
+        stm32_timer_tick();
+    }
+}
+
+/* stm32_get_time_us, reading the registers without clocking them */
+static uint64_t check_time_us(void)
+{
+    uint32_t ticks = systicks;
+    uint32_t val = host_systick.VAL;
+
+    if (host_scb.ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        ticks++;
+    }
+    return (uint64_t)ticks * STM32_US_PER_SYSTICK +
+           stm32_systick_phase(val, host_systick.LOAD) * STM32_US_PER_SYSTICK / (host_systick.LOAD + 1);
+}
+
+static void check_callback(stm32_timer_t *timer, void *param)
+{
+    (void)timer;
+    (void)param;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t sleeps = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+    stm32_timer_t timer;
+    uint64_t last = 0, now;
+    uint32_t backwards = 0;
+    double drift, max_drift = 0;
+    uint32_t i, run;
+
+    stm32_timer_init(&timer, check_callback, NULL);
+    host_systick.LOAD = CHECK_RELOAD;
+    host_systick.CTRL = SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk;
+
+    for (i = 0; i < sleeps; i++)
+    {
+        if (!stm32_timer_is_active(&timer))
+        {
+            stm32_timer_start(&timer, 1 + check_rand() % 300, 0);
+        }
+
+        /* run to a random phase of the tick, the time base read on every cycle */
+        for (run = check_rand() % (3 * (CHECK_RELOAD + 1)); run > 0; run--)
+        {
+            host_systick_clock();
+            now = check_time_us();
+            backwards += now < last;
+            last = now;
+            check_systick_handler();
+        }
+
+        stm32_tickless_idle();
+        now = check_time_us();
+        backwards += now < last;
+        last = now;
+        check_systick_handler();
+
+        drift = (double)check_time_us() - check_cycles * STM32_US_PER_SYSTICK / (CHECK_RELOAD + 1);
+        if (drift < 0)
+        {
+            drift = -drift;
+        }
+        if (drift > max_drift)
+        {
+            max_drift = drift;
+        }
+    }
+
+    printf("%u sleeps over %u systicks\n", sleeps, systicks);
+    printf("  time base went backwards %u times, largest drift %.1f us\n", backwards, max_drift);
+
+    return (backwards == 0 && max_drift < STM32_US_PER_SYSTICK) ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+/**
+ * Change Logs:
+ * Date           Author          Notes
+ * 2026-10-18     rgw             first version
+ */
+
+/*
+ * Host benchmark of the stm32_timer wheel: cost of arming, re-arming,
+ * cancelling and expiring thousands of timers, and a check that every
+ * timer fires on its exact tick.
+ *
+ * Build and run from the repository root:
+ *     cc -O2 -Itools/host -Istm32_drivers tools/timer_bench.c stm32_drivers/stm32_timer.c -o timer_bench
+ *     ./timer_bench [timers] [max delay in ticks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sdk_board.h"
+#include "stm32_common.h"
+#include "stm32_timer.h"
+
+SysTick_Type host_systick;
+
+stm32_critical_t stm32_critical_enter(void)
+{
+    return 0;
+}
+
+void stm32_critical_exit(stm32_critical_t state)
+{
+    (void)state;
+}
+
+struct bench_timer
+{
+    stm32_timer_t timer;
+    uint32_t due;               /* tick the callback must run on */
+    uint32_t fired;
+};
+
+static uint32_t bench_now;      /* ticks passed to stm32_timer_tick */
+static uint32_t bench_fired;
+static uint32_t bench_late;
+static uint32_t bench_seed = 1;
+
+static uint32_t bench_rand(void)
+{
+    bench_seed = bench_seed * 1664525 + 1013904223;
+    return bench_seed >> 8;
+}
+
+static double bench_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_callback(stm32_timer_t *timer, void *param)
+{
+    struct bench_timer *t = (struct bench_timer *)timer;
+
+    (void)param;
+    if (t->due != bench_now)
+    {
+        bench_late++;
+    }
+    t->fired++;
+    bench_fired++;
+}
+
+/* ticks run before a timer started with 'ticks' fires on the first of them */
+static void bench_arm(struct bench_timer *t, uint32_t ticks)
+{
+    stm32_timer_start(&t->timer, ticks, 0);
+    t->due = bench_now + (ticks == 0 ? 1 : ticks);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 4096;
+    uint32_t max_delay = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000;
+    struct bench_timer *timers = calloc(count, sizeof(struct bench_timer));
+    double start, arm, rearm, cancel, expire;
+    uint32_t ticks = 0;
+    uint32_t i;
+
+    if (timers == NULL || count == 0 || max_delay == 0)
+    {
+        fprintf(stderr, "usage: %s [timers] [max delay in ticks]\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        stm32_timer_init(&timers[i].timer, bench_callback, NULL);
+    }
+
+    start = bench_ns();
+    for (i = 0; i < count; i++)
+    {
+        bench_arm(&timers[i], 1 + bench_rand() % max_delay);
+    }
+    arm = bench_ns() - start;
+
+    start = bench_ns();
+    for (i = 0; i < count; i++)
+    {
+        bench_arm(&timers[i], 1 + bench_rand() % max_delay);
+    }
+    rearm = bench_ns() - start;
+
+    start = bench_ns();
+    for (i = 0; i < count; i++)
+    {
+        stm32_timer_stop(&timers[i].timer);
+    }
+    cancel = bench_ns() - start;
+
+    for (i = 0; i < count; i++)
+    {
+        bench_arm(&timers[i], 1 + bench_rand() % max_delay);
+    }
+    start = bench_ns();
+    while (bench_fired < count)
+    {
+        bench_now++;
+        stm32_timer_tick();
+        if (++ticks > max_delay + 1)
+        {
+            break;
+        }
+    }
+    expire = bench_ns() - start;
+
+    printf("%u timers, delays up to %u ticks\n", count, max_delay);
+    printf("  arm      %8.1f ns/timer\n", arm / count);
+    printf("  re-arm   %8.1f ns/timer\n", rearm / count);
+    printf("  cancel   %8.1f ns/timer\n", cancel / count);
+    printf("  expire   %8.1f ns/timer, %.1f ns/tick over %u ticks\n", expire / count, expire / ticks, ticks);
+    printf("  fired %u of %u, %u off their tick\n", bench_fired, count, bench_late);
+
+    for (i = 0; i < count; i++)
+    {
+        if (timers[i].fired != 1 || stm32_timer_is_active(&timers[i].timer))
+        {
+            printf("timer %u fired %u times\n", i, timers[i].fired);
+            return 1;
+        }
+    }
+
+    return (bench_fired == count && bench_late == 0) ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Per-span latency histograms from an stm32_trace capture (see stm32_trace.h).
+
+Packets (little endian):
+    1 BEGIN    id (u16) | ts (u32) | systicks (u32)
+    2 END      id (u16) | ts (u32) | systicks (u32)
+    3 COUNTER  id (u16) | ts (u32) | value (u32)
+    4 NAME     id (u16) | len (u8) | name
+    5 INFO     ts format (u8) | core clock (u32) | SysTick reload (u32)
+    6 LOST     dropped events (u32)
+
+Capture the RTT trace channel to a file, e.g. with JLinkRTTLogger -RTTChannel 2.
+
+Usage:
+    trace_hist.py [--clock HZ] capture.bin      (stdin when omitted)
+"""
+
+import argparse
+import struct
+import sys
+
+BEGIN, END, COUNTER, NAME, INFO, LOST = range(1, 7)
+TS_CYCCNT, TS_SYSTICK = 0, 1
+
+
+class Clock:
+    def __init__(self, hz):
+        self.hz = hz
+        self.format = TS_CYCCNT
+        self.reload = 0
+        self.last = None
+        self.cycles = 0
+        self.ticks = None
+        self.ticks_cycles = 0
+
+    def modulus(self):
+        if self.format == TS_SYSTICK:
+            return 256 * (self.reload + 1)
+        return 1 << 32
+
+    def raw(self, ts):
+        if self.format == TS_SYSTICK:
+            val = ts & 0xFFFFFF
+            # VAL counts down from the reload, 0 is the tick itself
+            phase = 0 if val == 0 else self.reload + 1 - val
+            return (ts >> 24) * (self.reload + 1) + phase
+        return ts
+
+    def unwrap(self, ts, ticks=None):
+        """Events are recorded in order, so each step is taken as forward.
+        ts alone wraps every modulus() cycles; the systicks of BEGIN and END
+        tell how many whole wraps a step spans, e.g. over a long erase."""
+        now = self.raw(ts)
+        if self.last is not None:
+            cycles = self.cycles + (now - self.last) % self.modulus()
+            if ticks is not None and self.ticks is not None and self.reload:
+                expect = self.ticks_cycles + ((ticks - self.ticks) & 0xFFFFFFFF) * (self.reload + 1)
+                cycles += max(0, round((expect - cycles) / self.modulus())) * self.modulus()
+            self.cycles = cycles
+        self.last = now
+        if ticks is not None:
+            self.ticks = ticks
+            self.ticks_cycles = self.cycles
+        return self.cycles
+
+
+def parse(data, clock):
+    pos = 0
+    while pos < len(data):
+        kind = data[pos]
+        if kind in (BEGIN, END) and pos + 11 <= len(data):
+            ident, ts, ticks = struct.unpack_from("<HII", data, pos + 1)
+            yield kind, ident, clock.unwrap(ts, ticks), None
+            pos += 11
+        elif kind == COUNTER and pos + 11 <= len(data):
+            ident, ts, value = struct.unpack_from("<HII", data, pos + 1)
+            yield kind, ident, clock.unwrap(ts), value
+            pos += 11
+        elif kind == NAME and pos + 4 <= len(data):
+            ident, size = struct.unpack_from("<HB", data, pos + 1)
+            name = data[pos + 4:pos + 4 + size].decode("utf-8", "replace")
+            yield kind, ident, None, name
+            pos += 4 + size
+        elif kind == INFO and pos + 10 <= len(data):
+            clock.format, hz, clock.reload = struct.unpack_from("<BII", data, pos + 1)
+            clock.hz = hz or clock.hz
+            clock.last = None
+            clock.ticks = None
+            pos += 10
+        elif kind == LOST and pos + 5 <= len(data):
+            yield kind, 0, None, struct.unpack_from("<I", data, pos + 1)[0]
+            pos += 5
+        else:
+            # truncated packet or garbage, resync on the next byte
+            pos += 1
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    ap.add_argument("--clock", type=int, default=32000000,
+                    help="core clock when the capture has no INFO packet")
+    ap.add_argument("capture", nargs="?")
+    args = ap.parse_args()
+
+    data = open(args.capture, "rb").read() if args.capture else sys.stdin.buffer.read()
+    clock = Clock(args.clock)
+    names = {}
+    open_spans = {}
+    spans = {}
+    counters = {}
+    lost = 0
+
+    for kind, ident, cycles, extra in parse(data, clock):
+        if kind == NAME:
+            names[ident] = extra
+        elif kind == LOST:
+            lost += extra
+            open_spans.clear()
+        elif kind == BEGIN:
+            open_spans.setdefault(ident, []).append(cycles)
+        elif kind == END and open_spans.get(ident):
+            spans.setdefault(ident, []).append(cycles - open_spans[ident].pop())
+        elif kind == COUNTER:
+            counters.setdefault(ident, []).append(extra)
+
+    us = 1e6 / clock.hz
+    for ident in sorted(spans):
+        values = sorted(spans[ident])
+        print("%s (id %d): %d spans, us min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f" % (
+            names.get(ident, "span"), ident, len(values), values[0] * us,
+            percentile(values, 50) * us, percentile(values, 90) * us,
+            percentile(values, 99) * us, values[-1] * us))
+        buckets = {}
+        for v in values:
+            b = int(v * us).bit_length()
+            buckets[b] = buckets.get(b, 0) + 1
+        top = max(buckets.values())
+        for b in sorted(buckets):
+            low = 0 if b == 0 else 1 << (b - 1)
+            print("  %8d us+ %7d %s" % (low, buckets[b], "#" * max(1, 50 * buckets[b] // top)))
+    for ident in sorted(counters):
+        values = counters[ident]
+        print("%s (id %d): %d samples, min %d max %d last %d" % (
+            names.get(ident, "counter"), ident, len(values), min(values), max(values), values[-1]))
+    if lost:
+        print("lost events: %d" % lost)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())